@@ -0,0 +1,110 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<uint64_t> alloc_calls { 0 };
+    std::atomic<uint64_t> alloc_bytes { 0 };
+
+    void* counted_alloc(size_t size) {
+        alloc_calls.fetch_add(1, std::memory_order_relaxed);
+        alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* counted_alloc(size_t size, std::align_val_t align) {
+        alloc_calls.fetch_add(1, std::memory_order_relaxed);
+        alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+
+        // aligned_alloc wants a multiple of the alignment
+        auto alignment = static_cast<size_t>(align);
+        size = (size + alignment - 1) & ~(alignment - 1);
+#ifdef _WIN32
+        return _aligned_malloc(size == 0 ? alignment : size, alignment);
+#else
+        return std::aligned_alloc(alignment, size == 0 ? alignment : size);
+#endif
+    }
+
+    void counted_free(void* ptr, std::align_val_t) noexcept {
+#ifdef _WIN32
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+}
+
+void* operator new(size_t size) {
+    if (void* p = counted_alloc(size)) {
+        return p;
+    }
+
+    throw std::bad_alloc {};
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    if (void* p = counted_alloc(size, align)) {
+        return p;
+    }
+
+    throw std::bad_alloc {};
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t align) noexcept { counted_free(ptr, align); }
+void operator delete[](void* ptr, std::align_val_t align) noexcept { counted_free(ptr, align); }
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept { counted_free(ptr, align); }
+void operator delete[](void* ptr, size_t, std::align_val_t align) noexcept { counted_free(ptr, align); }
+
+namespace bench {
+    alloc_count allocations() {
+        return { alloc_calls.load(std::memory_order_relaxed), alloc_bytes.load(std::memory_order_relaxed) };
+    }
+
+    alloc_scope::alloc_scope(benchmark::State& state) : _state { state }, _start { allocations() } { }
+
+    alloc_scope::~alloc_scope() {
+        alloc_count end = allocations();
+        _state.counters["allocs"] = benchmark::Counter(static_cast<double>(end.calls - _start.calls),
+            benchmark::Counter::kAvgIterations);
+        _state.counters["alloc_bytes"] = benchmark::Counter(static_cast<double>(end.bytes - _start.bytes),
+            benchmark::Counter::kAvgIterations);
+    }
+}
@@ -0,0 +1,52 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+/**
+ * Counts heap allocations made through the global operator new
+ */
+
+namespace bench {
+    struct alloc_count {
+        uint64_t calls;
+        uint64_t bytes;
+    };
+
+    /**
+     * @return Allocations made so far by all threads.
+     */
+    alloc_count allocations();
+
+    /**
+     * @brief Tracks the allocations made during a benchmark and reports
+     *          them per iteration as the `allocs` and `alloc_bytes` counters.
+     */
+    class alloc_scope {
+        benchmark::State& _state;
+        alloc_count _start;
+
+        public:
+        explicit alloc_scope(benchmark::State& state);
+        ~alloc_scope();
+
+        alloc_scope(const alloc_scope&) = delete;
+        alloc_scope& operator=(const alloc_scope&) = delete;
+    };
+}
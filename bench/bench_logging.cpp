@@ -0,0 +1,321 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "alloc_counter.h"
+
+#include "nao/log_fields.h"
+#include "nao/log_sink.h"
+#include "nao/logging.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+    /* Measures the logger itself rather than the terminal or disk behind it */
+    class null_sink : public nao::log_sink {
+        public:
+        void write(std::span<const std::string_view>) override { }
+    };
+
+    nao::log_category bench_category { "bench" };
+
+    void use_null_sink() {
+        nao::set_log_sink(std::make_unique<null_sink>());
+        nao::set_log_overflow(nao::log_overflow::block);
+        nao::set_log_level(nao::log_level::info);
+    }
+
+    void null_sink_setup(const benchmark::State&) {
+        use_null_sink();
+    }
+
+    /* Upper bound in nanoseconds of the bucket containing the `p`-th percentile */
+    double latency_percentile(const nao::log_statistics& before, const nao::log_statistics& after, double p) {
+        uint64_t total = 0;
+        for (size_t i = 0; i < after.latency_ns.size(); ++i) {
+            total += after.latency_ns[i] - before.latency_ns[i];
+        }
+
+        auto target = static_cast<uint64_t>(static_cast<double>(total) * p);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < after.latency_ns.size(); ++i) {
+            seen += after.latency_ns[i] - before.latency_ns[i];
+            if (seen > target) {
+                return static_cast<double>(uint64_t { 1 } << i);
+            }
+        }
+
+        return 0;
+    }
+
+    /* `p`-th percentile of `samples`, reorders them */
+    double sample_percentile(std::vector<uint64_t>& samples, double p) {
+        if (samples.empty()) {
+            return 0;
+        }
+
+        auto nth = samples.begin() + static_cast<ptrdiff_t>(static_cast<double>(samples.size() - 1) * p);
+        std::nth_element(samples.begin(), nth, samples.end());
+        return static_cast<double>(*nth);
+    }
+
+    /* Cost to the calling thread, the logging thread drains concurrently */
+    void logging_cout(benchmark::State& state) {
+        uint64_t i = 0;
+        {
+            bench::alloc_scope allocs { state };
+            for (auto _ : state) {
+                nao::coutln("transferred", i++, "of", 1'000'000, "bytes from", "depot", 3.5);
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations());
+        if (state.thread_index() == 0) {
+            nao::flush();
+        }
+    }
+    BENCHMARK(logging_cout)->Setup(null_sink_setup)->ThreadRange(1, 4)->UseRealTime();
+
+    /* Messages written into a memory_sink including the time to drain the queue */
+    void logging_memory_sink(benchmark::State& state) {
+        nao::set_log_sink(std::make_unique<nao::memory_sink>(1024));
+
+        auto batch = static_cast<uint64_t>(state.range(0));
+        for (auto _ : state) {
+            for (uint64_t i = 0; i < batch; ++i) {
+                nao::coutln("message", i, "of batch", batch);
+            }
+
+            nao::flush();
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+        use_null_sink();
+    }
+    BENCHMARK(logging_memory_sink)->Arg(64)->Arg(4096)->UseRealTime();
+
+    /* Baseline for batching: hands every message to the sink in a write of its own */
+    class per_message_sink : public nao::log_sink {
+        std::unique_ptr<nao::log_sink> _sink;
+
+        public:
+        explicit per_message_sink(std::unique_ptr<nao::log_sink> sink) : _sink { std::move(sink) } { }
+
+        void write(std::span<const std::string_view> messages) override {
+            for (const std::string_view& message : messages) {
+                _sink->write({ &message, 1 });
+            }
+        }
+
+        void flush() override {
+            _sink->flush();
+        }
+    };
+
+    void logging_memory_sink_per_message(benchmark::State& state) {
+        nao::set_log_sink(std::make_unique<per_message_sink>(std::make_unique<nao::memory_sink>(1024)));
+
+        auto batch = static_cast<uint64_t>(state.range(0));
+        for (auto _ : state) {
+            for (uint64_t i = 0; i < batch; ++i) {
+                nao::coutln("message", i, "of batch", batch);
+            }
+
+            nao::flush();
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+        use_null_sink();
+    }
+    BENCHMARK(logging_memory_sink_per_message)->Arg(64)->Arg(4096)->UseRealTime();
+
+    /* The sinks on their own, called with batches the way the logging thread calls them */
+    std::vector<std::string> sink_messages(size_t count) {
+        std::vector<std::string> messages;
+        for (size_t i = 0; i < count; ++i) {
+            messages.push_back("[info] transferred " + std::to_string(i * 4096) + " of 1000000 bytes from depot\n");
+        }
+
+        return messages;
+    }
+
+    std::filesystem::path sink_path(std::string_view name) {
+        return std::filesystem::temp_directory_path() / ("nao_bench_" + std::string { name } + ".log");
+    }
+
+    template <typename MakeSinkT>
+    void write_batches(benchmark::State& state, MakeSinkT make_sink, size_t batches_per_sink) {
+        const std::vector<std::string> messages = sink_messages(static_cast<size_t>(state.range(0)));
+        const std::vector<std::string_view> batch { messages.begin(), messages.end() };
+
+        size_t bytes = 0;
+        for (const std::string& message : messages) {
+            bytes += message.size();
+        }
+
+        std::unique_ptr<nao::log_sink> sink = make_sink();
+        size_t batches = 0;
+        for (auto _ : state) {
+            sink->write(batch);
+            sink->flush();
+
+            // Start over now and then so that appending sinks don't fill the disk
+            if (++batches == batches_per_sink) {
+                state.PauseTiming();
+                sink.reset();
+                sink = make_sink();
+                batches = 0;
+                state.ResumeTiming();
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    }
+
+    void logging_file_sink_write(benchmark::State& state) {
+        auto path = sink_path("file");
+        write_batches(state, [&] {
+            std::filesystem::remove(path);
+            return std::make_unique<nao::file_sink>(path);
+        }, 1024);
+
+        std::filesystem::remove(path);
+    }
+    BENCHMARK(logging_file_sink_write)->Arg(64);
+
+    /* Rotates every few batches, which renames the files and reopens the active one */
+    void logging_rotating_file_sink_write(benchmark::State& state) {
+        auto path = sink_path("rotating");
+        write_batches(state, [&] {
+            return std::make_unique<nao::rotating_file_sink>(path, 256 * 1024, std::chrono::seconds::zero(), 2);
+        }, SIZE_MAX);
+
+        for (const char* suffix : { "", ".1", ".2" }) {
+            std::filesystem::remove(path.string() + suffix);
+        }
+    }
+    BENCHMARK(logging_rotating_file_sink_write)->Arg(64);
+
+    void logging_memory_sink_write(benchmark::State& state) {
+        write_batches(state, [] {
+            return std::make_unique<nao::memory_sink>(1024);
+        }, SIZE_MAX);
+    }
+    BENCHMARK(logging_memory_sink_write)->Arg(64);
+
+    /* Caller latency is timed over batches of a few calls to amortize the clock reads, queue latency
+     * is the time from the call until the logging thread wrote the message */
+    void logging_deferred(benchmark::State& state) {
+        use_null_sink();
+        nao::flush();
+        nao::log_statistics before = nao::log_stats();
+
+        constexpr uint64_t batch = 8;
+        std::vector<uint64_t> batch_ns;
+        batch_ns.reserve(size_t { 1 } << 20);
+
+        uint64_t i = 0;
+        {
+            bench::alloc_scope allocs { state };
+            auto batch_start = std::chrono::steady_clock::now();
+            for (auto _ : state) {
+                nao::cout_deferred<"transferred {} of {} bytes from {}\n">(i++, uint64_t { 1'000'000 }, "depot");
+
+                if (i % batch == 0) {
+                    auto now = std::chrono::steady_clock::now();
+                    if (batch_ns.size() < batch_ns.capacity()) {
+                        batch_ns.push_back(static_cast<uint64_t>(std::chrono::nanoseconds { now - batch_start }.count()));
+                    }
+
+                    batch_start = now;
+                }
+            }
+        }
+
+        nao::flush();
+        nao::log_statistics after = nao::log_stats();
+
+        state.SetItemsProcessed(state.iterations());
+        state.counters["call_p50_ns"] = sample_percentile(batch_ns, 0.50) / batch;
+        state.counters["call_p99_ns"] = sample_percentile(batch_ns, 0.99) / batch;
+        state.counters["call_p999_ns"] = sample_percentile(batch_ns, 0.999) / batch;
+        state.counters["queue_latency_p50_ns"] = latency_percentile(before, after, 0.50);
+        state.counters["queue_latency_p99_ns"] = latency_percentile(before, after, 0.99);
+        state.counters["queue_latency_p999_ns"] = latency_percentile(before, after, 0.999);
+    }
+    BENCHMARK(logging_deferred);
+
+    /* Below the threshold nothing may be formatted */
+    void logging_level_filtered(benchmark::State& state) {
+        use_null_sink();
+        nao::set_log_level(nao::log_level::warn);
+
+        bench::alloc_scope allocs { state };
+        uint64_t i = 0;
+        for (auto _ : state) {
+            nao::debug("filtered", i++);
+            nao::log<nao::log_level::info>(bench_category, "filtered", i);
+        }
+
+        nao::set_log_level(nao::log_level::info);
+    }
+    BENCHMARK(logging_level_filtered);
+
+    void logging_levelled(benchmark::State& state) {
+        use_null_sink();
+
+        bench::alloc_scope allocs { state };
+        uint64_t i = 0;
+        for (auto _ : state) {
+            nao::log<nao::log_level::info>(bench_category, "app", i++, "updated to build", 12345);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+        nao::flush();
+    }
+    BENCHMARK(logging_levelled);
+
+    void logging_fields(benchmark::State& state) {
+        use_null_sink();
+        nao::set_log_encoding(static_cast<nao::log_encoding>(state.range(0)));
+
+        uint64_t i = 0;
+        {
+            bench::alloc_scope allocs { state };
+            for (auto _ : state) {
+                nao::log_fields<nao::log_level::info>(bench_category, "download finished",
+                    nao::field("appid", i++), nao::field("path", "steamapps/common/\"quoted\""),
+                    nao::field("rate", 1.5e6), nao::field("verified", true));
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations());
+        nao::flush();
+        nao::set_log_encoding(nao::log_encoding::json);
+    }
+    BENCHMARK(logging_fields)->ArgName("binary")->Arg(0)->Arg(1);
+}
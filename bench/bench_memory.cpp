@@ -0,0 +1,210 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "alloc_counter.h"
+
+#include "nao/arena.h"
+#include "nao/intern.h"
+#include "nao/mapped_file.h"
+#include "nao/progress.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    std::vector<std::string> distinct_keys(size_t count) {
+        std::vector<std::string> keys;
+        keys.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            keys.push_back("InstalledDepots/" + std::to_string(i * 7919));
+        }
+
+        return keys;
+    }
+
+    /* Lookups of strings that are already in the pool, shared by all threads */
+    void intern_hit(benchmark::State& state) {
+        static nao::intern_pool pool;
+        static const std::vector<std::string> keys = distinct_keys(1024);
+
+        if (state.thread_index() == 0) {
+            for (const std::string& key : keys) {
+                pool.intern(key);
+            }
+        }
+
+        size_t i = static_cast<size_t>(state.thread_index()) * 31;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(pool.intern(keys[i++ % keys.size()]));
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(intern_hit)->ThreadRange(1, 4)->UseRealTime();
+
+    /* Every string is new, each pool is filled from empty */
+    void intern_miss(benchmark::State& state) {
+        std::vector<std::string> keys = distinct_keys(static_cast<size_t>(state.range(0)));
+
+        for (auto _ : state) {
+            nao::intern_pool pool;
+            for (const std::string& key : keys) {
+                benchmark::DoNotOptimize(pool.intern(key));
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(intern_miss)->Arg(1024);
+
+    void intern_find(benchmark::State& state) {
+        nao::intern_pool pool;
+        std::vector<std::string> keys = distinct_keys(1024);
+        for (size_t i = 0; i < keys.size(); i += 2) {
+            pool.intern(keys[i]);
+        }
+
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(pool.find(keys[i++ % keys.size()]));
+        }
+    }
+    BENCHMARK(intern_find);
+
+    /* Builds a small vector of strings per iteration, from the arena or from the heap */
+    template <bool UseArena>
+    void arena_strings(benchmark::State& state) {
+        nao::arena arena;
+        std::pmr::memory_resource* resource = UseArena ? &arena : std::pmr::new_delete_resource();
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            {
+                std::pmr::vector<std::pmr::string> strings { resource };
+                for (int i = 0; i < 16; ++i) {
+                    strings.emplace_back("a string that does not fit in the SSO buffer");
+                }
+
+                benchmark::DoNotOptimize(strings.data());
+            }
+
+            if constexpr (UseArena) {
+                arena.reset();
+            }
+        }
+    }
+    BENCHMARK(arena_strings<true>)->Name("arena_strings");
+    BENCHMARK(arena_strings<false>)->Name("arena_strings_heap");
+
+    void arena_allocate(benchmark::State& state) {
+        nao::arena arena;
+        auto size = static_cast<size_t>(state.range(0));
+
+        size_t count = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(arena.allocate(size, alignof(std::max_align_t)));
+
+            // Keep the working set bounded
+            if (++count == 4096) {
+                arena.reset();
+                count = 0;
+            }
+        }
+    }
+    BENCHMARK(arena_allocate)->Arg(16)->Arg(256);
+
+    /* Hot path of a transfer loop, contended by all threads */
+    std::unique_ptr<nao::progress> shared_meter;
+
+    void progress_add(benchmark::State& state) {
+        for (auto _ : state) {
+            shared_meter->add(4096);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(progress_add)
+        ->Setup([](const benchmark::State&) {
+            shared_meter = std::make_unique<nao::progress>(0, nao::progress_options { "bench", std::chrono::hours { 1 } });
+        })
+        ->Teardown([](const benchmark::State&) {
+            shared_meter.reset();
+        })
+        ->ThreadRange(1, 4)->UseRealTime();
+
+    void progress_line(benchmark::State& state) {
+        nao::progress meter { 1ull << 40, nao::progress_options { "bench", std::chrono::hours { 1 } } };
+        meter.add(123'456'789);
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(meter.line());
+        }
+    }
+    BENCHMARK(progress_line);
+
+    /* Temporary file of `size` bytes, removed again on destruction */
+    class temp_file {
+        std::filesystem::path _path;
+
+        public:
+        explicit temp_file(size_t size)
+            : _path { std::filesystem::temp_directory_path() / ("nao_bench_" + std::to_string(size) + ".bin") } {
+            std::string data(size, 'x');
+            std::ofstream { _path, std::ios::binary }.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+
+        ~temp_file() {
+            std::filesystem::remove(_path);
+        }
+
+        const std::filesystem::path& path() const { return _path; }
+    };
+
+    /* Maps the file and scans it, the file is in the page cache after the first iteration */
+    void mapped_file_read(benchmark::State& state) {
+        temp_file file { static_cast<size_t>(state.range(0)) };
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            nao::mapped_file mapped { file.path() };
+            benchmark::DoNotOptimize(std::count(mapped.begin(), mapped.end(), '\n'));
+        }
+
+        state.SetBytesProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(mapped_file_read)->Arg(64 << 10)->Arg(16 << 20);
+
+    /* Baseline: reads the whole file into a string before scanning it */
+    void mapped_file_read_baseline(benchmark::State& state) {
+        temp_file file { static_cast<size_t>(state.range(0)) };
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            std::ifstream in { file.path(), std::ios::binary };
+            std::string data(static_cast<size_t>(state.range(0)), '\0');
+            in.read(data.data(), static_cast<std::streamsize>(data.size()));
+            benchmark::DoNotOptimize(std::count(data.begin(), data.end(), '\n'));
+        }
+
+        state.SetBytesProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(mapped_file_read_baseline)->Arg(64 << 10)->Arg(16 << 20);
+}
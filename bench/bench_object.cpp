@@ -0,0 +1,87 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "alloc_counter.h"
+
+#include "nao/event.h"
+#include "nao/object.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+namespace {
+    class counting_object : public nao::object {
+        uint64_t _handled = 0;
+
+        public:
+        explicit counting_object(nao::object* parent = nullptr) : nao::object { parent } { }
+
+        bool event(nao::event& ev) override {
+            if (ev.type() == nao::event_type {}) {
+                ++_handled;
+                return true;
+            }
+
+            return false;
+        }
+    };
+
+    /* Children are owned by the root, so this includes tearing the tree down */
+    void object_tree(benchmark::State& state) {
+        auto children = static_cast<size_t>(state.range(0));
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            counting_object root;
+            for (size_t i = 0; i < children; ++i) {
+                benchmark::DoNotOptimize(root.add_child<counting_object>());
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(object_tree)->Arg(16)->Arg(1024);
+
+    /* One virtual call per object, the event itself is reused */
+    void object_event(benchmark::State& state) {
+        counting_object root;
+        std::vector<nao::object*> targets;
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            targets.push_back(root.add_child<counting_object>());
+        }
+
+        nao::event ev { nao::event_type {} };
+        for (auto _ : state) {
+            for (nao::object* target : targets) {
+                benchmark::DoNotOptimize(target->event(ev));
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(object_event)->Arg(16)->Arg(1024);
+
+    /* Events are polymorphic, so posting one usually means a heap allocation */
+    void event_create(benchmark::State& state) {
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            auto ev = std::make_unique<nao::event>(nao::event_type {});
+            benchmark::DoNotOptimize(ev->type());
+        }
+    }
+    BENCHMARK(event_create);
+}
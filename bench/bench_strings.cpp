@@ -0,0 +1,149 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "alloc_counter.h"
+
+#include "nao/strings.h"
+
+#include "legacy/strings.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <string>
+
+namespace {
+    /* Spread over every prefix so the branch predictor can't learn a single path */
+    constexpr std::array<uint64_t, 8> sizes {
+        0, 999, 1023, 1536, 5'000'000, 123'456'789'012, 1ull << 50, ~0ull,
+    };
+
+    constexpr std::array<uint64_t, 4> durations {
+        0, 59'999'999'999, 3'723'004'000'000, 200'000'000'000'000,
+    };
+
+    void strings_bytes(benchmark::State& state) {
+        bench::alloc_scope allocs { state };
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::bytes(sizes[i++ % sizes.size()]));
+        }
+    }
+    BENCHMARK(strings_bytes);
+
+    /* The stringstream version bytes() replaced */
+    void strings_bytes_baseline(benchmark::State& state) {
+        bench::alloc_scope allocs { state };
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao_legacy::bytes(sizes[i++ % sizes.size()]));
+        }
+    }
+    BENCHMARK(strings_bytes_baseline);
+
+    void strings_bits(benchmark::State& state) {
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::bits(sizes[i++ % sizes.size()]));
+        }
+    }
+    BENCHMARK(strings_bits);
+
+    void strings_percent(benchmark::State& state) {
+        double v = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::percent(v));
+            v += 0.00123;
+        }
+    }
+    BENCHMARK(strings_percent);
+
+    void strings_time_hours(benchmark::State& state) {
+        bench::alloc_scope allocs { state };
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::time_hours(durations[i++ % durations.size()]));
+        }
+    }
+    BENCHMARK(strings_time_hours);
+
+    void strings_time_hours_baseline(benchmark::State& state) {
+        bench::alloc_scope allocs { state };
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao_legacy::time_hours(durations[i++ % durations.size()]));
+        }
+    }
+    BENCHMARK(strings_time_hours_baseline);
+
+    void strings_time_minutes(benchmark::State& state) {
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::time_minutes(durations[i++ % durations.size()], false));
+        }
+    }
+    BENCHMARK(strings_time_minutes);
+
+    /* The allocation-free path, into a caller buffer */
+    void strings_to_chars(benchmark::State& state) {
+        char buf[nao::formatted_size_max];
+
+        bench::alloc_scope allocs { state };
+        size_t i = 0;
+        for (auto _ : state) {
+            uint64_t n = sizes[i++ % sizes.size()];
+            benchmark::DoNotOptimize(nao::to_chars(buf, buf + sizeof(buf), nao::byte_size { n }));
+            benchmark::DoNotOptimize(nao::to_chars(buf, buf + sizeof(buf), nao::unit_value { n, nao::si_bit_rate }));
+            benchmark::DoNotOptimize(nao::to_chars(buf, buf + sizeof(buf), nao::percentage { 0.4567 }));
+            benchmark::ClobberMemory();
+        }
+    }
+    BENCHMARK(strings_to_chars);
+
+    void strings_format_units(benchmark::State& state) {
+        nao::unit_format format { "B", "bytes", nao::unit_system::si, 2, 0, false };
+
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::format_units(sizes[i++ % sizes.size()], format));
+        }
+    }
+    BENCHMARK(strings_format_units);
+
+    void strings_format_duration(benchmark::State& state) {
+        char buf[nao::formatted_size_max];
+        nao::duration_format format { nao::time_unit::days, 3 };
+
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::format_duration(buf, buf + sizeof(buf), durations[i++ % durations.size()], format));
+            benchmark::ClobberMemory();
+        }
+    }
+    BENCHMARK(strings_format_duration);
+
+    void strings_parse_duration(benchmark::State& state) {
+        constexpr std::array<std::string_view, 4> inputs { "00:00:00", "59.999", "1:02:03.004", "2d 07:33:20.5" };
+
+        size_t i = 0;
+        for (auto _ : state) {
+            std::string_view str = inputs[i++ % inputs.size()];
+            uint64_t ns;
+            benchmark::DoNotOptimize(nao::parse_duration(str.data(), str.data() + str.size(), ns));
+            benchmark::DoNotOptimize(ns);
+        }
+    }
+    BENCHMARK(strings_parse_duration);
+}
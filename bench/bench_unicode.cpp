@@ -0,0 +1,354 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "alloc_counter.h"
+
+#include "nao/strings.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+    /* Arg(0) is pure ASCII, Arg(1) mixes in 2, 3 and 4 byte sequences, Arg(2) only 2 and 3 byte ones */
+    std::string utf8_input(int64_t text, size_t size) {
+        static constexpr std::string_view pieces[] = {
+            "steamapps/common/Half-Life 2/hl2.exe ",
+            "Ōkami 日本語 Ελληνικά 🎮 ",
+            "Größe Ōkami 日本語 Ελληνικά ",
+        };
+
+        std::string str;
+        while (str.size() < size) {
+            str.append(pieces[text]);
+        }
+
+        return str;
+    }
+
+    constexpr size_t input_size = 64 * 1024;
+
+    void set_bytes(benchmark::State& state, size_t size) {
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+    }
+
+    void unicode_validate_utf8(benchmark::State& state) {
+        std::string str = utf8_input(state.range(0), input_size);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::validate_utf8(str));
+        }
+
+        set_bytes(state, str.size());
+    }
+    BENCHMARK(unicode_validate_utf8)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    void unicode_to_utf16(benchmark::State& state) {
+        std::string str = utf8_input(state.range(0), input_size);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::to_utf16(str));
+        }
+
+        set_bytes(state, str.size());
+    }
+    BENCHMARK(unicode_to_utf16)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    void unicode_to_utf16_buffer(benchmark::State& state) {
+        std::string str = utf8_input(state.range(0), input_size);
+        std::vector<char16_t> out(nao::utf16_length_bound(str.size()));
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::to_utf16(str, out.data()));
+            benchmark::ClobberMemory();
+        }
+
+        set_bytes(state, str.size());
+    }
+    BENCHMARK(unicode_to_utf16_buffer)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    void unicode_to_utf8(benchmark::State& state) {
+        std::u16string str = nao::to_u16string(utf8_input(state.range(0), input_size));
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::to_utf8(std::u16string_view { str }));
+        }
+
+        set_bytes(state, str.size() * sizeof(char16_t));
+    }
+    BENCHMARK(unicode_to_utf8)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    /* Same as unicode_to_utf16, but char16_t on every platform */
+    void unicode_to_u16string(benchmark::State& state) {
+        std::string str = utf8_input(state.range(0), input_size);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::to_u16string(str));
+        }
+
+        set_bytes(state, str.size());
+    }
+    BENCHMARK(unicode_to_u16string)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    /*
+     * Baseline: what to_utf16 and to_utf8 did before the single pass transcoders, one pass
+     * for the size and one to convert. That is MultiByteToWideChar and WideCharToMultiByte
+     * on Windows, and an equally strict scalar decoder run twice elsewhere.
+     */
+#ifdef _WIN32
+    using utf16_string = std::wstring;
+
+    std::wstring two_pass_to_utf16(std::string_view str) {
+        int size = MultiByteToWideChar(
+            CP_UTF8, MB_ERR_INVALID_CHARS,
+            str.data(), static_cast<int>(str.size()),
+            nullptr, 0);
+
+        std::wstring result(size, '\0');
+
+        int converted = MultiByteToWideChar(
+            CP_UTF8, MB_ERR_INVALID_CHARS,
+            str.data(), static_cast<int>(str.size()),
+            result.data(), size);
+
+        if (converted != size) {
+            throw std::runtime_error("failed converting narrow string to wide string");
+        }
+
+        return result;
+    }
+
+    std::string two_pass_to_utf8(std::wstring_view str) {
+        int size = WideCharToMultiByte(
+            CP_UTF8, WC_COMPOSITECHECK | WC_NO_BEST_FIT_CHARS,
+            str.data(), static_cast<int>(str.size()),
+            nullptr, 0, nullptr, nullptr);
+
+        std::string result(size, '\0');
+
+        int converted = WideCharToMultiByte(
+            CP_UTF8, WC_COMPOSITECHECK | WC_NO_BEST_FIT_CHARS,
+            str.data(), static_cast<int>(str.size()),
+            result.data(), size, nullptr, nullptr);
+
+        if (converted != size) {
+            throw std::runtime_error("failed converting wide string to narrow string");
+        }
+
+        return result;
+    }
+#else
+    using utf16_string = std::u16string;
+
+    // Size of the sequence at str[i], or 0 if it is invalid
+    size_t decode_utf8(std::string_view str, size_t i, char32_t& cp) {
+        auto byte = [&](size_t k) { return static_cast<uint8_t>(str[i + k]); };
+
+        uint8_t c = byte(0);
+        size_t size = c < 0x80 ? 1 : c < 0xC2 ? 0 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : c < 0xF5 ? 4 : 0;
+        if (size == 0 || i + size > str.size()) {
+            return 0;
+        }
+
+        cp = size == 1 ? c : c & (0x7F >> size);
+        for (size_t k = 1; k < size; ++k) {
+            if ((byte(k) & 0xC0) != 0x80) {
+                return 0;
+            }
+
+            cp = (cp << 6) | (byte(k) & 0x3F);
+        }
+
+        static constexpr char32_t min[] = { 0, 0, 0x80, 0x800, 0x10000 };
+        if (cp < min[size] || cp > 0x10FFFF || (cp >= 0xD800 && cp < 0xE000)) {
+            return 0;
+        }
+
+        return size;
+    }
+
+    std::u16string two_pass_to_utf16(std::string_view str) {
+        size_t size = 0;
+        char32_t cp;
+        for (size_t i = 0, n; i < str.size(); i += n) {
+            n = decode_utf8(str, i, cp);
+            if (n == 0) {
+                throw std::runtime_error("failed converting narrow string to wide string");
+            }
+
+            size += cp > 0xFFFF ? 2 : 1;
+        }
+
+        std::u16string result(size, u'\0');
+
+        size_t o = 0;
+        for (size_t i = 0; i < str.size(); i += decode_utf8(str, i, cp)) {
+            if (cp > 0xFFFF) {
+                result[o++] = static_cast<char16_t>(0xD7C0 + (cp >> 10));
+                result[o++] = static_cast<char16_t>(0xDC00 | (cp & 0x3FF));
+            } else {
+                result[o++] = static_cast<char16_t>(cp);
+            }
+        }
+
+        return result;
+    }
+
+    // Code point at str[i], lone surrogates become U+FFFD
+    size_t decode_utf16(std::u16string_view str, size_t i, char32_t& cp) {
+        char32_t c = str[i];
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < str.size() && str[i + 1] >= 0xDC00 && str[i + 1] < 0xE000) {
+            cp = 0x10000 + ((c - 0xD800) << 10) + (str[i + 1] - 0xDC00);
+            return 2;
+        }
+
+        cp = (c >= 0xD800 && c < 0xE000) ? 0xFFFD : c;
+        return 1;
+    }
+
+    std::string two_pass_to_utf8(std::u16string_view str) {
+        size_t size = 0;
+        char32_t cp;
+        for (size_t i = 0; i < str.size(); i += decode_utf16(str, i, cp)) {
+            size += cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+        }
+
+        std::string result(size, '\0');
+
+        size_t o = 0;
+        for (size_t i = 0; i < str.size(); i += decode_utf16(str, i, cp)) {
+            if (cp < 0x80) {
+                result[o++] = static_cast<char>(cp);
+            } else if (cp < 0x800) {
+                result[o++] = static_cast<char>(0xC0 | (cp >> 6));
+                result[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                result[o++] = static_cast<char>(0xE0 | (cp >> 12));
+                result[o++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                result[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+            } else {
+                result[o++] = static_cast<char>(0xF0 | (cp >> 18));
+                result[o++] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                result[o++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                result[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+
+        return result;
+    }
+#endif
+
+    void unicode_to_utf16_two_pass(benchmark::State& state) {
+        std::string str = utf8_input(state.range(0), input_size);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(two_pass_to_utf16(str));
+        }
+
+        set_bytes(state, str.size());
+    }
+    BENCHMARK(unicode_to_utf16_two_pass)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    void unicode_to_utf8_two_pass(benchmark::State& state) {
+        utf16_string str = two_pass_to_utf16(utf8_input(state.range(0), input_size));
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(two_pass_to_utf8(str));
+        }
+
+        set_bytes(state, str.size() * sizeof(utf16_string::value_type));
+    }
+    BENCHMARK(unicode_to_utf8_two_pass)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    void unicode_append_utf8(benchmark::State& state) {
+        std::wstring str = nao::to_utf16(utf8_input(state.range(0), 256));
+        std::string out;
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            out.clear();
+            nao::append_utf8(out, str);
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    BENCHMARK(unicode_append_utf8)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    void unicode_to_utf32(benchmark::State& state) {
+        std::string str = utf8_input(state.range(0), input_size);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::to_utf32(str));
+        }
+
+        set_bytes(state, str.size());
+    }
+    BENCHMARK(unicode_to_utf32)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    void unicode_utf32_to_utf8(benchmark::State& state) {
+        std::u32string str = nao::to_utf32(utf8_input(state.range(0), input_size));
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(nao::to_utf8(std::u32string_view { str }));
+        }
+
+        set_bytes(state, str.size() * sizeof(char32_t));
+    }
+    BENCHMARK(unicode_utf32_to_utf8)->ArgName("text")->Arg(0)->Arg(1)->Arg(2);
+
+    void unicode_latin1(benchmark::State& state) {
+        std::string latin1;
+        for (size_t i = 0; i < input_size; ++i) {
+            latin1.push_back(static_cast<char>(i % 4 == 0 ? 0xE9 : 'a' + i % 26));
+        }
+
+        for (auto _ : state) {
+            std::string utf8 = nao::latin1_to_utf8(latin1);
+            benchmark::DoNotOptimize(nao::utf8_to_latin1(utf8));
+        }
+
+        set_bytes(state, latin1.size());
+    }
+    BENCHMARK(unicode_latin1);
+
+    /* Feeds the input in chunks that split sequences */
+    void unicode_stream(benchmark::State& state) {
+        std::string str = utf8_input(1, input_size);
+        auto chunk = static_cast<size_t>(state.range(0));
+
+        std::u16string utf16;
+        std::string utf8;
+        for (auto _ : state) {
+            utf16.clear();
+            utf8.clear();
+
+            nao::utf8_to_utf16_stream to16;
+            for (size_t i = 0; i < str.size(); i += chunk) {
+                to16.feed(std::string_view { str }.substr(i, chunk), utf16);
+            }
+            to16.finish();
+
+            nao::utf16_to_utf8_stream to8;
+            for (size_t i = 0; i < utf16.size(); i += chunk) {
+                to8.feed(std::u16string_view { utf16 }.substr(i, chunk), utf8);
+            }
+            to8.finish(utf8);
+
+            benchmark::DoNotOptimize(utf8.data());
+        }
+
+        set_bytes(state, str.size());
+    }
+    BENCHMARK(unicode_stream)->ArgName("chunk")->Arg(7)->Arg(4096);
+}
@@ -0,0 +1,202 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "alloc_counter.h"
+#include "vdf_gen.h"
+
+#include "nao/arena.h"
+#include "nao/vdf.h"
+
+#include <vdf_parser.h>
+
+#include "legacy/vdf_parser.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace {
+    /* Generated once per size, shared by all parsers */
+    const std::string& document(size_t size) {
+        static std::map<size_t, std::string> documents;
+
+        auto it = documents.find(size);
+        if (it == documents.end()) {
+            it = documents.emplace(size, bench::generate_vdf(size)).first;
+        }
+
+        return it->second;
+    }
+
+    template <typename OutputT>
+    void vdf_read(benchmark::State& state) {
+        const std::string& doc = document(static_cast<size_t>(state.range(0)));
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            auto root = tyti::vdf::read<OutputT>(doc.begin(), doc.end());
+            benchmark::DoNotOptimize(&root);
+        }
+
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * doc.size()));
+    }
+
+    /* The parser before the tokenizer rewrite, compare with vdf_read_object */
+    void vdf_read_baseline(benchmark::State& state) {
+        const std::string& doc = document(static_cast<size_t>(state.range(0)));
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            auto root = tyti_legacy::vdf::read<tyti_legacy::vdf::object>(doc.begin(), doc.end());
+            benchmark::DoNotOptimize(&root);
+        }
+
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * doc.size()));
+    }
+
+    /* Everything the parser allocates comes from one arena, reset between documents */
+    void vdf_read_pmr_arena(benchmark::State& state) {
+        const std::string& doc = document(static_cast<size_t>(state.range(0)));
+        nao::arena arena;
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            {
+                nao::resource_scope scope { arena };
+                auto root = tyti::vdf::read<nao::vdf::pmr_object>(doc.begin(), doc.end());
+                benchmark::DoNotOptimize(root.childs.size());
+            }
+
+            arena.reset();
+        }
+
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * doc.size()));
+    }
+
+    void vdf_document(benchmark::State& state) {
+        const std::string& doc = document(static_cast<size_t>(state.range(0)));
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            nao::vdf::document root { std::string_view { doc } };
+            benchmark::DoNotOptimize(root->childs.size());
+        }
+
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * doc.size()));
+    }
+
+    /* Includes mapping the file, which is in the page cache after the first iteration */
+    void vdf_document_mapped(benchmark::State& state) {
+        const std::string& doc = document(static_cast<size_t>(state.range(0)));
+
+        auto path = std::filesystem::temp_directory_path() / ("nao_bench_" + std::to_string(doc.size()) + ".vdf");
+        std::ofstream { path, std::ios::binary }.write(doc.data(), static_cast<std::streamsize>(doc.size()));
+
+        {
+            bench::alloc_scope allocs { state };
+            for (auto _ : state) {
+                nao::vdf::document root { path };
+                benchmark::DoNotOptimize(root->childs.size());
+            }
+        }
+
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * doc.size()));
+        std::filesystem::remove(path);
+    }
+
+    /* Visits every event without building anything, the floor for all of the above */
+    struct counting_handler {
+        size_t events = 0;
+
+        bool on_object_begin(std::string_view) { ++events; return true; }
+        bool on_key_value(std::string_view, std::string_view) { ++events; return true; }
+        bool on_object_end() { ++events; return true; }
+    };
+
+    void vdf_parse(benchmark::State& state) {
+        const std::string& doc = document(static_cast<size_t>(state.range(0)));
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            counting_handler handler;
+            tyti::vdf::parse(doc.begin(), doc.end(), handler);
+            benchmark::DoNotOptimize(handler.events);
+        }
+
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * doc.size()));
+    }
+
+    /* Fed in chunks of state.range(1) bytes, every boundary splits whatever it hits */
+    void vdf_push(benchmark::State& state) {
+        const std::string& doc = document(static_cast<size_t>(state.range(0)));
+        const size_t chunk = static_cast<size_t>(state.range(1));
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            counting_handler handler;
+            tyti::vdf::push_parser<counting_handler> parser { handler };
+            for (size_t i = 0; i < doc.size(); i += chunk) {
+                parser.feed(doc.data() + i, std::min(chunk, doc.size() - i));
+            }
+            parser.finish();
+            benchmark::DoNotOptimize(handler.events);
+        }
+
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * doc.size()));
+    }
+
+    /* Includes copying out of the stream buffer */
+    template <typename OutputT>
+    void vdf_read_stream(benchmark::State& state) {
+        const std::string& doc = document(static_cast<size_t>(state.range(0)));
+
+        bench::alloc_scope allocs { state };
+        for (auto _ : state) {
+            std::istringstream in { doc };
+            auto root = tyti::vdf::read<OutputT>(in);
+            benchmark::DoNotOptimize(&root);
+        }
+
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * doc.size()));
+    }
+
+    void vdf_sizes(benchmark::internal::Benchmark* b) {
+        b->RangeMultiplier(16)->Range(4 << 10, 1 << 20);
+    }
+
+    /* Where the tokenizer's scanning dominates, compare with a -DTYTI_VDF_NO_SIMD build */
+    void vdf_large_sizes(benchmark::internal::Benchmark* b) {
+        b->Arg(4 << 20)->Arg(16 << 20)->Unit(benchmark::kMillisecond);
+    }
+
+    BENCHMARK(vdf_read<tyti::vdf::object>)->Name("vdf_read_object")->Apply(vdf_sizes)->Apply(vdf_large_sizes);
+    BENCHMARK(vdf_read_baseline)->Apply(vdf_sizes)->Apply(vdf_large_sizes);
+    BENCHMARK(vdf_read<tyti::vdf::multikey_object>)->Name("vdf_read_multikey_object")->Apply(vdf_sizes);
+    BENCHMARK(vdf_read<nao::vdf::interned_object>)->Name("vdf_read_interned_object")->Apply(vdf_sizes);
+    BENCHMARK(vdf_read<tyti::vdf::flat_object>)->Name("vdf_read_flat_object")->Apply(vdf_sizes)->Apply(vdf_large_sizes);
+    BENCHMARK(vdf_read<nao::vdf::pmr_object>)->Name("vdf_read_pmr_object")->Apply(vdf_sizes);
+    BENCHMARK(vdf_read_pmr_arena)->Apply(vdf_sizes);
+    BENCHMARK(vdf_parse)->Apply(vdf_sizes)->Apply(vdf_large_sizes);
+    BENCHMARK(vdf_push)->ArgsProduct({ { 1 << 20 }, { 16, 4 << 10, 64 << 10 } });
+    BENCHMARK(vdf_read_stream<tyti::vdf::object>)->Name("vdf_read_stream_object")->Apply(vdf_sizes);
+    BENCHMARK(vdf_read_stream<tyti::vdf::flat_object>)->Name("vdf_read_stream_flat_object")->Apply(vdf_sizes);
+    BENCHMARK(vdf_document)->Apply(vdf_sizes)->Apply(vdf_large_sizes);
+    BENCHMARK(vdf_document_mapped)->Apply(vdf_sizes);
+}
@@ -0,0 +1,130 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "vdf_gen.h"
+
+#include <array>
+#include <string_view>
+
+namespace {
+    /* splitmix64, unlike the standard distributions its output is fully specified */
+    class rng {
+        uint64_t _state;
+
+        public:
+        explicit rng(uint64_t seed) : _state { seed } { }
+
+        uint64_t next() {
+            uint64_t z = (_state += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            return z ^ (z >> 31);
+        }
+
+        uint64_t below(uint64_t n) {
+            return next() % n;
+        }
+    };
+
+    constexpr std::array<std::string_view, 12> key_names {
+        "appid", "name", "installdir", "LastUpdated", "SizeOnDisk", "buildid",
+        "StateFlags", "manifest", "size", "path", "label", "contentid",
+    };
+
+    constexpr std::array<std::string_view, 8> object_names {
+        "AppState", "InstalledDepots", "UserConfig", "MountedConfig",
+        "apps", "libraryfolders", "SharedDepots", "InstallScripts",
+    };
+
+    constexpr std::array<std::string_view, 6> words {
+        "Steam", "Half-Life", "common", "Ōkami", "Ελληνικά", "日本語",
+    };
+
+    void indent(std::string& out, size_t depth) {
+        out.append(depth, '\t');
+    }
+
+    void value(std::string& out, rng& r) {
+        switch (r.below(4)) {
+            case 0:
+            case 1:
+                out.append(std::to_string(r.next() >> (r.below(48) + 16)));
+                break;
+
+            case 2:
+                out.append("C:\\\\Program Files (x86)\\\\Steam\\\\steamapps\\\\");
+                out.append(words[r.below(words.size())]);
+                break;
+
+            default:
+                out.append(words[r.below(words.size())]);
+                out.append(" \\\"edition\\\" ");
+                out.append(std::to_string(r.below(100)));
+                break;
+        }
+    }
+
+    void object(std::string& out, rng& r, size_t depth, size_t size) {
+        while (out.size() < size) {
+            uint64_t pick = r.below(16);
+            if (pick == 0 && depth > 0) {
+                return;
+            }
+
+            if (pick == 1) {
+                indent(out, depth);
+                out.append("// generated comment ").append(std::to_string(r.below(1000))).push_back('\n');
+                continue;
+            }
+
+            indent(out, depth);
+            out.push_back('"');
+            if (pick < 4 && depth < 6) {
+                out.append(object_names[r.below(object_names.size())]);
+                out.append("\"\n");
+                indent(out, depth);
+                out.append("{\n");
+                object(out, r, depth + 1, size);
+                indent(out, depth);
+                out.append("}\n");
+                continue;
+            }
+
+            out.append(key_names[r.below(key_names.size())]);
+            out.append(std::to_string(r.below(64)));
+            out.append("\"\t\t\"");
+            value(out, r);
+            out.append("\"\n");
+        }
+    }
+}
+
+namespace bench {
+    std::string generate_vdf(size_t size, uint64_t seed) {
+        rng r { seed };
+
+        std::string out;
+        out.reserve(size + 4096);
+        out.append("\"root\"\n{\n");
+
+        // Objects close on their own or once the size is reached, the loop covers the former
+        while (out.size() < size) {
+            object(out, r, 1, size);
+        }
+
+        out.append("}\n");
+        return out;
+    }
+}
@@ -0,0 +1,34 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Synthetic VDF (Valve KeyValues) documents
+ */
+
+namespace bench {
+    /**
+     * @brief Generates a VDF document of roughly `size` bytes, shaped like Steam's
+     *          manifests: nested objects with numeric, path and free-text values,
+     *          escaped quotes, comments and some non-ASCII text.
+     * @param size - Approximate size of the document in bytes
+     * @param seed - The same seed always produces the same document, on every platform
+     */
+    std::string generate_vdf(size_t size, uint64_t seed = 1);
+}
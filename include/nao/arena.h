@@ -0,0 +1,114 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace nao {
+    /**
+     * @brief Bump allocator that hands out memory from large chunks and frees it all at once.
+     *
+     * Deallocation only reclaims the most recent allocation, everything else is
+     * freed by release(), reset() or the destructor. Not thread-safe.
+     */
+    class arena : public std::pmr::memory_resource {
+        struct chunk {
+            chunk* prev;
+            size_t size;
+        };
+
+        std::pmr::memory_resource* _upstream;
+        chunk* _head = nullptr;
+        std::byte* _pos = nullptr;
+        std::byte* _end = nullptr;
+
+        size_t _first_size;
+        size_t _next_size;
+        size_t _used = 0;
+        size_t _reserved = 0;
+
+        chunk* _new_chunk(size_t size);
+        void _free_chunks(chunk* until);
+
+        public:
+        /**
+         * @param initial_size - Size of the first chunk, later chunks double in size up to 1 MiB
+         * @param upstream - Where chunks are allocated from
+         */
+        explicit arena(size_t initial_size = 4096,
+            std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+        ~arena() override;
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        /**
+         * @brief Frees all chunks, invalidating everything allocated from the arena.
+         */
+        void release();
+
+        /**
+         * @brief Invalidates everything allocated from the arena, but keeps the most
+         *          recent chunk to allocate from again. Meant for loops that fill an
+         *          arena and discard it for every batch.
+         */
+        void reset();
+
+        /**
+         * @return The number of bytes handed out since the last release or reset.
+         */
+        [[nodiscard]] size_t used() const noexcept { return _used; }
+
+        /**
+         * @return The number of bytes held in chunks.
+         */
+        [[nodiscard]] size_t reserved() const noexcept { return _reserved; }
+
+        protected:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    using arena_string = std::pmr::string;
+
+    template <typename T>
+    using arena_vector = std::pmr::vector<T>;
+
+    /**
+     * @return The resource set by the innermost resource_scope on this thread,
+     *          or std::pmr::get_default_resource() outside of any.
+     */
+    std::pmr::memory_resource* current_resource() noexcept;
+
+    /**
+     * @brief Sets the resource returned by current_resource() on this thread for its lifetime,
+     *          for types that are default constructed by code that does not take an allocator.
+     */
+    class resource_scope {
+        std::pmr::memory_resource* _prev;
+
+        public:
+        explicit resource_scope(std::pmr::memory_resource& resource) noexcept;
+        ~resource_scope();
+
+        resource_scope(const resource_scope&) = delete;
+        resource_scope& operator=(const resource_scope&) = delete;
+    };
+}
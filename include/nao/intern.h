@@ -0,0 +1,135 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+namespace nao {
+    namespace detail {
+        /**
+         * @brief Header of an interned string, the characters and a null terminator follow it.
+         */
+        struct intern_entry {
+            size_t hash;
+            size_t size;
+
+            [[nodiscard]] const char* data() const {
+                return reinterpret_cast<const char*>(this + 1);
+            }
+        };
+    }
+
+    /**
+     * @brief Handle to a string stored in an intern_pool.
+     *
+     * Handles from the same pool are equal exactly if their strings are, which is
+     * a pointer comparison, and their hash is stored alongside the string.
+     * A default constructed handle holds the empty string, but is not equal to
+     * the handle of an interned empty string.
+     */
+    class interned {
+        const detail::intern_entry* _entry = nullptr;
+
+        friend class intern_pool;
+        explicit interned(const detail::intern_entry* entry) : _entry { entry } { }
+
+        public:
+        interned() = default;
+
+        [[nodiscard]] const char* data() const { return _entry ? _entry->data() : ""; }
+        [[nodiscard]] const char* c_str() const { return data(); }
+        [[nodiscard]] size_t size() const { return _entry ? _entry->size : 0; }
+        [[nodiscard]] bool empty() const { return size() == 0; }
+        [[nodiscard]] size_t hash() const { return _entry ? _entry->hash : 0; }
+
+        [[nodiscard]] std::string_view view() const { return { data(), size() }; }
+        operator std::string_view() const { return view(); }
+
+        /**
+         * @return Whether this handle refers to an interned string.
+         */
+        explicit operator bool() const { return _entry != nullptr; }
+
+        friend bool operator==(interned lhs, interned rhs) = default;
+    };
+
+    inline std::ostream& operator<<(std::ostream& os, interned str) {
+        return os << str.view();
+    }
+
+    /**
+     * @brief Thread-safe set of deduplicated strings, which stay valid as long as the pool.
+     * @note Strings are stored in a nao::arena per shard.
+     */
+    class intern_pool {
+        struct shard;
+        static constexpr size_t shard_count = 16;
+
+        std::array<std::unique_ptr<shard>, shard_count> _shards;
+
+        public:
+        intern_pool();
+        ~intern_pool();
+
+        intern_pool(const intern_pool&) = delete;
+        intern_pool& operator=(const intern_pool&) = delete;
+
+        /**
+         * @return The handle for `str`, adding it to the pool if it is not in it yet.
+         * @note Lookups of strings already in the pool only take a shared lock.
+         */
+        interned intern(std::string_view str);
+
+        /**
+         * @return The handle for `str`, or an empty handle if it is not in the pool.
+         */
+        [[nodiscard]] interned find(std::string_view str) const;
+
+        /**
+         * @return The number of distinct strings in the pool.
+         */
+        [[nodiscard]] size_t size() const;
+
+        /**
+         * @return The number of bytes allocated for the strings.
+         */
+        [[nodiscard]] size_t memory_used() const;
+    };
+
+    /**
+     * @return The pool used by nao::intern, which lives until the program exits.
+     */
+    intern_pool& default_intern_pool();
+
+    /**
+     * @brief Interns `str` in the default pool.
+     */
+    inline interned intern(std::string_view str) {
+        return default_intern_pool().intern(str);
+    }
+}
+
+template <>
+struct std::hash<nao::interned> {
+    size_t operator()(nao::interned str) const noexcept {
+        return str.hash();
+    }
+};
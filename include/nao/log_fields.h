@@ -0,0 +1,320 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#pragma once
+
+#include "nao/logging.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/**
+ * Structured (key/value) logging
+ */
+
+namespace nao {
+    /**
+     * @brief Output format of structured messages.
+     */
+    enum class log_encoding {
+        // One JSON object per line
+        json,
+
+        // Length-prefixed binary records, see binary_encoder. All other messages
+        // are wrapped in records as well, so that the output holds nothing else.
+        binary,
+    };
+
+    /**
+     * @brief Sets the format structured messages are encoded in, JSON Lines by default.
+     * @throws std::runtime_error if `encoding` is log_encoding::binary and the
+     *          current sink does not accept binary data
+     */
+    void set_log_encoding(log_encoding encoding);
+
+    /**
+     * @brief A named value attached to a structured message.
+     */
+    template <typename T>
+    struct log_field {
+        std::string_view key;
+        const T& value;
+    };
+
+    template <detail::log_fast T>
+    log_field<T> field(std::string_view key, const T& value) {
+        return { key, value };
+    }
+
+    /**
+     * @brief Writes a message as a single-line JSON object:
+     *          `{"level":"info","category":"net","msg":"...","key":value,...}`
+     */
+    class json_encoder {
+        std::string& _out;
+
+        public:
+        json_encoder(std::string& out, log_level level, std::string_view category, std::string_view message)
+            : _out { out } {
+            _out.append("{\"level\":\"").append(detail::level_name(level)).push_back('"');
+            if (!category.empty()) {
+                _key("category");
+                _string(category);
+            }
+
+            _key("msg");
+            _string(message);
+        }
+
+        template <typename T>
+        void field(std::string_view key, const T& value) {
+            _key(key);
+
+            if constexpr (std::convertible_to<const T&, std::string_view>) {
+                _string(value);
+            } else if constexpr (detail::log_char<T>) {
+                char c = static_cast<char>(value);
+                _string({ &c, 1 });
+            } else if constexpr (std::same_as<T, bool>) {
+                _out.append(value ? "true" : "false");
+            } else if constexpr (std::floating_point<T>) {
+                // JSON has no representation for these
+                if (!std::isfinite(value)) {
+                    _out.append("null");
+                } else {
+                    char buf[64];
+                    auto res = std::to_chars(std::begin(buf), std::end(buf), value);
+                    _out.append(buf, res.ptr);
+                }
+            } else {
+                char buf[32];
+                auto res = std::to_chars(std::begin(buf), std::end(buf), value);
+                _out.append(buf, res.ptr);
+            }
+        }
+
+        void finish() {
+            _out.append("}\n");
+        }
+
+        private:
+        void _key(std::string_view key) {
+            _out.push_back(',');
+            _string(key);
+            _out.push_back(':');
+        }
+
+        void _string(std::string_view str) {
+            static constexpr char hex[] = "0123456789abcdef";
+
+            _out.push_back('"');
+
+            // Copy runs of characters that need no escaping at once
+            size_t start = 0;
+            for (size_t i = 0; i < str.size(); ++i) {
+                auto c = static_cast<unsigned char>(str[i]);
+                if (c >= 0x20 && c != '"' && c != '\\') {
+                    continue;
+                }
+
+                _out.append(str.substr(start, i - start));
+                start = i + 1;
+
+                switch (c) {
+                    case '"':  _out.append("\\\""); break;
+                    case '\\': _out.append("\\\\"); break;
+                    case '\n': _out.append("\\n"); break;
+                    case '\r': _out.append("\\r"); break;
+                    case '\t': _out.append("\\t"); break;
+                    default: {
+                        char esc[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+                        _out.append(esc, sizeof(esc));
+                        break;
+                    }
+                }
+            }
+
+            _out.append(str.substr(start));
+            _out.push_back('"');
+        }
+    };
+
+    /**
+     * @brief Writes a message as a compact binary record, all integers little-endian:
+     *
+     *  - u32 size of the rest of the record
+     *  - u8 level
+     *  - string category, string message
+     *  - u16 number of fields, each consisting of:
+     *      - string key
+     *      - u8 type, followed by the value:
+     *          0: bool as u8, 1: i64, 2: u64, 3: f64 (IEEE 754 bits), 4: string
+     *
+     *  Strings are stored as a u32 size followed by the bytes.
+     *
+     *  While this is the log encoding, messages that are not structured become records
+     *  with the level `off`, an empty category, the text as the message and no fields.
+     *  The logger's own reports are wrapped the same way, at their actual level.
+     */
+    class binary_encoder {
+        std::string& _out;
+        size_t _start;
+        size_t _count_pos;
+        uint16_t _count = 0;
+
+        public:
+        enum class type : uint8_t {
+            boolean,
+            int64,
+            uint64,
+            float64,
+            string,
+        };
+
+        binary_encoder(std::string& out, log_level level, std::string_view category, std::string_view message)
+            : _out { out }, _start { out.size() } {
+            _integer(uint32_t { 0 });
+            _integer(static_cast<uint8_t>(level));
+            _string(category);
+            _string(message);
+
+            _count_pos = _out.size();
+            _integer(uint16_t { 0 });
+        }
+
+        template <typename T>
+        void field(std::string_view key, const T& value) {
+            _string(key);
+            ++_count;
+
+            if constexpr (std::convertible_to<const T&, std::string_view>) {
+                _integer(static_cast<uint8_t>(type::string));
+                _string(value);
+            } else if constexpr (detail::log_char<T>) {
+                char c = static_cast<char>(value);
+                _integer(static_cast<uint8_t>(type::string));
+                _string({ &c, 1 });
+            } else if constexpr (std::same_as<T, bool>) {
+                _integer(static_cast<uint8_t>(type::boolean));
+                _integer(static_cast<uint8_t>(value));
+            } else if constexpr (std::floating_point<T>) {
+                double d = static_cast<double>(value);
+                uint64_t bits;
+                std::memcpy(&bits, &d, sizeof(bits));
+
+                _integer(static_cast<uint8_t>(type::float64));
+                _integer(bits);
+            } else if constexpr (std::is_signed_v<T>) {
+                _integer(static_cast<uint8_t>(type::int64));
+                _integer(static_cast<uint64_t>(static_cast<int64_t>(value)));
+            } else {
+                _integer(static_cast<uint8_t>(type::uint64));
+                _integer(static_cast<uint64_t>(value));
+            }
+        }
+
+        void finish() {
+            _patch(_count_pos, _count);
+            _patch(_start, static_cast<uint32_t>(_out.size() - _start - sizeof(uint32_t)));
+        }
+
+        private:
+        template <std::unsigned_integral T>
+        void _integer(T value) {
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                _out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+            }
+        }
+
+        template <std::unsigned_integral T>
+        void _patch(size_t pos, T value) {
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                _out[pos + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+        }
+
+        void _string(std::string_view str) {
+            _integer(static_cast<uint32_t>(str.size()));
+            _out.append(str);
+        }
+    };
+
+    namespace detail {
+        extern std::atomic<log_encoding> structured_encoding;
+
+        /**
+         * @brief Copies an encoded binary_encoder record into the log queue.
+         */
+        void log_write_binary(std::string_view record);
+
+        template <typename Encoder, typename... Fields>
+        void encode_fields(log_level level, std::string_view category,
+            std::string_view message, const log_field<Fields>&... fields) {
+            std::string& buf = log_buffer();
+            buf.clear();
+
+            Encoder encoder { buf, level, category, message };
+            (encoder.field(fields.key, fields.value), ...);
+            encoder.finish();
+
+            // Tells the log thread not to wrap the record in another one
+            if constexpr (std::same_as<Encoder, binary_encoder>) {
+                log_write_binary(buf);
+            } else {
+                log_write(buf);
+            }
+        }
+
+        template <typename... Fields>
+        void log_fields_line(log_level level, std::string_view category,
+            std::string_view message, const log_field<Fields>&... fields) {
+            if (structured_encoding.load(std::memory_order_relaxed) == log_encoding::binary) {
+                encode_fields<binary_encoder>(level, category, message, fields...);
+            } else {
+                encode_fields<json_encoder>(level, category, message, fields...);
+            }
+        }
+    }
+
+    /**
+     * @brief Logs a structured message at `Level` in the given category.
+     * @note Filtered the same way as nao::log, fields are encoded straight into
+     *          the per-thread log buffer.
+     */
+    template <log_level Level, typename... Fields>
+    void log_fields(const log_category& category, std::string_view message, const log_field<Fields>&... fields) {
+        if constexpr (Level >= min_log_level) {
+            if (category.enabled(Level)) {
+                detail::log_fields_line(Level, category.name(), message, fields...);
+            }
+        }
+    }
+
+    /**
+     * @brief Logs a structured message at `Level`, filtered by the global level.
+     */
+    template <log_level Level, typename... Fields>
+    void log_fields(std::string_view message, const log_field<Fields>&... fields) {
+        if constexpr (Level >= min_log_level) {
+            if (Level >= detail::log_threshold.load(std::memory_order_relaxed)) {
+                detail::log_fields_line(Level, {}, message, fields...);
+            }
+        }
+    }
+}
@@ -0,0 +1,201 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Output targets for the asynchronous logger
+ */
+
+namespace nao {
+    /**
+     * @brief Destination of log output. All functions except the constructor,
+     *          destructor and accepts_binary are only ever called from the logging thread.
+     * @note Exceptions thrown by write and flush are counted in log_statistics::sink_errors,
+     *          the messages being written are lost.
+     */
+    class log_sink {
+        public:
+        virtual ~log_sink() = default;
+
+        /**
+         * @brief Writes a batch of messages, in the order they were logged.
+         */
+        virtual void write(std::span<const std::string_view> messages) = 0;
+
+        /**
+         * @brief Pushes out anything the sink has buffered.
+         * @note Called whenever the logging thread runs out of work.
+         */
+        virtual void flush() { }
+
+        /**
+         * @return Whether the sink can take arbitrary bytes, such as log_encoding::binary records.
+         */
+        virtual bool accepts_binary() const { return true; }
+    };
+
+    /**
+     * @brief Base class for sinks that collect batches in a buffer and only
+     *          write it out when it is full or when flushed.
+     */
+    class buffered_sink : public log_sink {
+        std::string _buffer;
+        size_t _capacity;
+
+        public:
+        /**
+         * @param capacity - Size of the write buffer in bytes
+         */
+        explicit buffered_sink(size_t capacity);
+
+        void write(std::span<const std::string_view> messages) override;
+        void flush() override;
+
+        protected:
+        /**
+         * @brief Writes out a chunk of buffered data.
+         */
+        virtual void commit(std::string_view data) = 0;
+    };
+
+    /**
+     * @brief Writes to a C stream such as stdout or stderr.
+     */
+    class stream_sink : public buffered_sink {
+        std::FILE* _stream;
+
+        public:
+        explicit stream_sink(std::FILE* stream, size_t capacity = 64 * 1024);
+
+        protected:
+        void commit(std::string_view data) override;
+    };
+
+    /**
+     * @brief Appends to a file.
+     */
+    class file_sink : public buffered_sink {
+        std::ofstream _file;
+
+        public:
+        explicit file_sink(const std::filesystem::path& path, size_t capacity = 1024 * 1024);
+
+        protected:
+        void commit(std::string_view data) override;
+    };
+
+    /**
+     * @brief Appends to a file, which is moved aside once it grows too large or too old.
+     * @note Old files get a numbered suffix, `.1` being the most recent one.
+     *          Files are split at newlines, so it can't be used with log_encoding::binary.
+     */
+    class rotating_file_sink : public buffered_sink {
+        std::filesystem::path _path;
+        uint64_t _max_size;
+        std::chrono::seconds _max_age;
+        size_t _max_files;
+
+        std::ofstream _file;
+        uint64_t _size = 0;
+        std::chrono::steady_clock::time_point _opened;
+
+        public:
+        /**
+         * @param path - Path of the active log file
+         * @param max_size - Rotate before the file would exceed this many bytes, 0 for no limit.
+         *          Files are split between lines, a line longer than this gets a file of its own.
+         * @param max_age - Rotate once the file has been open this long, 0 for no limit
+         * @param max_files - Number of rotated files to keep
+         */
+        rotating_file_sink(std::filesystem::path path, uint64_t max_size,
+            std::chrono::seconds max_age = std::chrono::seconds::zero(), size_t max_files = 5,
+            size_t capacity = 1024 * 1024);
+
+        bool accepts_binary() const override;
+
+        protected:
+        void commit(std::string_view data) override;
+
+        private:
+        void _open();
+        void _rotate();
+        void _write(std::string_view data);
+    };
+
+    /**
+     * @brief Keeps the most recent messages in memory, mostly useful for testing.
+     */
+    class memory_sink : public log_sink {
+        mutable std::mutex _mutex;
+        std::vector<std::string> _messages;
+        size_t _next = 0;
+        bool _wrapped = false;
+
+        public:
+        /**
+         * @param capacity - Number of messages to keep
+         */
+        explicit memory_sink(size_t capacity = 1024);
+
+        void write(std::span<const std::string_view> messages) override;
+
+        /**
+         * @return The stored messages, oldest first. Safe to call from any thread.
+         */
+        std::vector<std::string> messages() const;
+
+        /**
+         * @brief Discards all stored messages.
+         */
+        void clear();
+    };
+
+#ifdef _WIN32
+    /**
+     * @brief Writes to the debugger output through OutputDebugStringW.
+     * @note Only takes UTF-8 text, so it can't be used with log_encoding::binary.
+     */
+    class debug_sink : public buffered_sink {
+        public:
+        explicit debug_sink(size_t capacity = 64 * 1024);
+
+        bool accepts_binary() const override;
+
+        protected:
+        void commit(std::string_view data) override;
+    };
+#endif
+
+    /**
+     * @brief Replaces the sink the logging thread writes to.
+     * @note The previous sink is flushed and destroyed. The default sink is a
+     *          debug_sink on Windows and a stream_sink for stderr elsewhere.
+     * @throws std::runtime_error if structured messages are encoded as log_encoding::binary
+     *          and the sink does not accept binary data
+     */
+    void set_log_sink(std::unique_ptr<log_sink> sink);
+}
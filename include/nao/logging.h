@@ -15,13 +15,321 @@
 
 #pragma once
 
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <concepts>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if __has_include(<format>)
+#include <format>
+#endif
+
+// Levelled messages below this level are compiled out, 0 (trace) through 5 (off)
+#ifndef NAO_LOG_MIN_LEVEL
+#define NAO_LOG_MIN_LEVEL 0
+#endif
 
 /**
  * Asynchronous logging, function interface
  */
 
 namespace nao {
+    /**
+     * @brief Action taken when a message is logged while the log queue is full.
+     */
+    enum class log_overflow {
+        // Wait until the logging thread has made room (default)
+        block,
+
+        // Discard the message being logged
+        drop_newest,
+
+        // Discard the oldest queued message to make room
+        drop_oldest,
+    };
+
+    /**
+     * @brief Sets the policy applied when the log queue is full.
+     * @note Dropped messages are reported in the log output with their count.
+     */
+    void set_log_overflow(log_overflow policy);
+
+    namespace detail {
+        /**
+         * @brief Copies a formatted message into the log queue.
+         */
+        void log_write(std::string_view str);
+
+        /**
+         * @brief Per-thread buffer messages are formatted into, reused across calls.
+         */
+        inline std::string& log_buffer() {
+            thread_local std::string buffer;
+            return buffer;
+        }
+
+        /**
+         * @brief Stream buffer appending to a std::string.
+         */
+        class string_appender : public std::streambuf {
+            std::string* _str = nullptr;
+
+            public:
+            void set_target(std::string& str) {
+                _str = &str;
+            }
+
+            protected:
+            int_type overflow(int_type ch) override {
+                if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                    _str->push_back(traits_type::to_char_type(ch));
+                }
+
+                return traits_type::not_eof(ch);
+            }
+
+            std::streamsize xsputn(const char_type* s, std::streamsize count) override {
+                _str->append(s, static_cast<size_t>(count));
+                return count;
+            }
+        };
+
+        template <typename T>
+        concept log_char = std::same_as<T, char> || std::same_as<T, signed char> || std::same_as<T, unsigned char>;
+
+        /**
+         * @brief Types that are formatted without going through an ostream.
+         */
+        template <typename T>
+        concept log_fast = std::convertible_to<const T&, std::string_view>
+            || log_char<T> || std::same_as<T, bool>
+            || std::integral<T> || std::floating_point<T>;
+
+        /**
+         * @brief Appends `value` to `out`, producing the same text as operator<<
+         *          on a default-constructed stream.
+         */
+        template <log_fast T>
+        void log_append(std::string& out, const T& value) {
+            if constexpr (std::convertible_to<const T&, std::string_view>) {
+                out.append(std::string_view { value });
+            } else if constexpr (log_char<T>) {
+                out.push_back(static_cast<char>(value));
+            } else if constexpr (std::same_as<T, bool>) {
+                out.push_back(value ? '1' : '0');
+            } else {
+                // Enough for any integer or "%g" formatted floating point value
+                char buf[64];
+                std::to_chars_result res;
+                if constexpr (std::floating_point<T>) {
+                    res = std::to_chars(std::begin(buf), std::end(buf), value, std::chars_format::general, 6);
+                } else {
+                    res = std::to_chars(std::begin(buf), std::end(buf), value);
+                }
+
+                out.append(buf, res.ptr);
+            }
+        }
+
+        /**
+         * @brief Formats `args` into `out`, separated by spaces.
+         */
+        template <typename... Args>
+        void log_format(std::string& out, const Args&... args) {
+            if constexpr ((log_fast<std::remove_cvref_t<Args>> && ...)) {
+                bool first = true;
+                auto append = [&out, &first](const auto& arg) {
+                    if (!first) {
+                        out.push_back(' ');
+                    }
+
+                    first = false;
+                    log_append(out, arg);
+                };
+
+                (append(args), ...);
+            } else {
+                // Any other type may depend on (or change) stream state, so use a stream for all
+                thread_local string_appender buf;
+                thread_local std::ostream stream { &buf };
+
+                buf.set_target(out);
+                bool first = true;
+                auto append = [&first](const auto& arg) {
+                    if (!first) {
+                        stream << ' ';
+                    }
+
+                    first = false;
+                    stream << arg;
+                };
+
+                (append(args), ...);
+
+                // Undo whatever manipulators were passed
+                stream.flags(std::ios_base::skipws | std::ios_base::dec);
+                stream.precision(6);
+                stream.width(0);
+                stream.fill(' ');
+                stream.clear();
+            }
+        }
+    }
+
+    namespace detail {
+        /**
+         * @brief Static description of a deferred message, turns its captured arguments into text.
+         */
+        struct deferred_format {
+            std::string_view fmt;
+            void (*decode)(std::string& out, std::string_view fmt, const char* args);
+        };
+
+        /**
+         * @brief Queues a deferred message, `args` holds its arguments as captured by deferred_encode.
+         */
+        void log_write_deferred(const deferred_format& format, std::string_view args);
+
+        /**
+         * @brief String literal usable as a template argument.
+         */
+        template <size_t N>
+        struct format_literal {
+            char str[N];
+
+            consteval format_literal(const char (&s)[N]) {
+                std::copy_n(s, N, str);
+            }
+
+            constexpr std::string_view view() const {
+                return { str, N - 1 };
+            }
+        };
+
+        consteval size_t count_placeholders(std::string_view fmt) {
+            size_t count = 0;
+            for (size_t pos = fmt.find("{}"); pos != std::string_view::npos; pos = fmt.find("{}", pos + 2)) {
+                ++count;
+            }
+
+            return count;
+        }
+
+        /**
+         * @brief Type an argument is captured as, strings are copied by value.
+         */
+        template <typename T>
+        using deferred_t = std::conditional_t<std::convertible_to<const T&, std::string_view>,
+            std::string_view, std::remove_cvref_t<T>>;
+
+        template <typename T>
+        void deferred_encode(std::string& out, const T& value) {
+            if constexpr (std::same_as<deferred_t<T>, std::string_view>) {
+                std::string_view str { value };
+                size_t size = str.size();
+                out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+                out.append(str);
+            } else {
+                out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+        }
+
+        template <typename T>
+        T deferred_read(const char*& args) {
+            if constexpr (std::same_as<T, std::string_view>) {
+                size_t size;
+                std::memcpy(&size, args, sizeof(size));
+                std::string_view str { args + sizeof(size), size };
+                args += sizeof(size) + size;
+                return str;
+            } else {
+                T value;
+                std::memcpy(&value, args, sizeof(value));
+                args += sizeof(value);
+                return value;
+            }
+        }
+
+        /**
+         * @brief Replaces each `{}` in `fmt` by the next captured argument, run on the logging thread.
+         */
+        template <typename... Args>
+        void deferred_decode(std::string& out, std::string_view fmt, const char* args) {
+            size_t pos = 0;
+            [[maybe_unused]] auto put = [&]<typename T>(std::type_identity<T>) {
+                size_t brace = fmt.find("{}", pos);
+                out.append(fmt.substr(pos, brace - pos));
+                pos = brace + 2;
+                log_append(out, deferred_read<T>(args));
+            };
+
+            (put(std::type_identity<Args> {}), ...);
+            out.append(fmt.substr(pos));
+        }
+
+        template <format_literal Fmt, typename... Args>
+        inline constexpr deferred_format deferred_descriptor { Fmt.view(), &deferred_decode<Args...> };
+    }
+
+    /**
+     * @brief Blocks until every message logged before the call has been written
+     *          to the sink (or dropped) and the sink has been flushed.
+     */
+    void flush();
+
+    /**
+     * @brief Whether messages still queued at program exit are written out
+     *          before the logging thread stops (default) or discarded.
+     */
+    void set_log_drain_on_exit(bool drain);
+
+    /**
+     * @brief Snapshot of the asynchronous logger's counters.
+     */
+    struct log_statistics {
+        static constexpr size_t latency_buckets = 40;
+
+        // Messages accepted into a queue, including ones evicted by drop_oldest
+        uint64_t enqueued;
+
+        // Messages handed to the sink
+        uint64_t written;
+
+        // Messages discarded by the overflow policy
+        uint64_t dropped;
+
+        // Messages currently waiting in the queues
+        uint64_t queued;
+
+        // Largest number of messages taken from the queues at once, the high-water mark of the queue depth
+        uint64_t max_batch;
+
+        // Bytes written to the sink and time spent in its write and flush functions
+        uint64_t sink_bytes;
+        double sink_seconds;
+        double sink_bytes_per_second;
+
+        // Calls to the sink's write and flush functions that threw
+        uint64_t sink_errors;
+
+        // Time from logging a message until it was written, bucket `i` counts
+        // latencies below 2^i nanoseconds (and at least 2^(i-1)), the last bucket
+        // everything above.
+        std::array<uint64_t, latency_buckets> latency_ns;
+    };
+
+    /**
+     * @return The current values of the logger's counters.
+     * @note Reading the counters never blocks the logging threads.
+     */
+    log_statistics log_stats();
+
     /**
      * @brief Prints a string to the standard output stream.
      * @param str - The string to print.
@@ -29,15 +337,16 @@ namespace nao {
     void cout(std::string str);
 
     /**
-     * @brief Variadic version of cout, for printing multiple arguments, formatted with a stringstream.
+     * @brief Variadic version of cout, for printing multiple arguments separated by spaces.
+     * @note Formats into a buffer that is reused across calls, so this does not allocate
+     *          once the buffer and the log queue have grown to fit the messages logged.
      */
     template <typename... Args>
     void cout(Args&&... args) {
-        std::stringstream ss;
-        ((ss << args << ' '), ...);
-        auto str = ss.str();
-        // Select the correct overload and remove the trailing space
-        static_cast<void(*)(std::string)>(cout)(str.substr(0, str.size() - 1));
+        std::string& buf = detail::log_buffer();
+        buf.clear();
+        detail::log_format(buf, args...);
+        detail::log_write(buf);
     }
 
     /**
@@ -47,4 +356,203 @@ namespace nao {
     void coutln(Args&&... args) {
         cout(args..., '\n');
     }
+
+    /**
+     * @brief Logs a message of which all formatting is deferred to the logging thread.
+     * @param Fmt - Format string in which each `{}` is replaced by the next argument
+     * @note Only the raw bytes of the arguments are captured, strings are copied.
+     *          Supports the same types as the allocation-free path of cout.
+     */
+    template <detail::format_literal Fmt, detail::log_fast... Args>
+    void cout_deferred(const Args&... args) {
+        static_assert(detail::count_placeholders(Fmt.view()) == sizeof...(Args),
+            "number of {} in the format string does not match the number of arguments");
+
+        std::string& buf = detail::log_buffer();
+        buf.clear();
+        (detail::deferred_encode(buf, args), ...);
+        detail::log_write_deferred(detail::deferred_descriptor<Fmt, detail::deferred_t<Args>...>, buf);
+    }
+
+#ifdef __cpp_lib_format
+    /**
+     * @brief Prints arguments formatted through std::format, with the format string checked at compile time.
+     */
+    template <typename... Args>
+    void coutf(std::format_string<Args...> fmt, Args&&... args) {
+        std::string& buf = detail::log_buffer();
+        buf.clear();
+        std::format_to(std::back_inserter(buf), fmt, std::forward<Args>(args)...);
+        detail::log_write(buf);
+    }
+
+    /**
+     * @brief Version of coutf which additionally adds a newline at the end.
+     */
+    template <typename... Args>
+    void coutfln(std::format_string<Args...> fmt, Args&&... args) {
+        std::string& buf = detail::log_buffer();
+        buf.clear();
+        std::format_to(std::back_inserter(buf), fmt, std::forward<Args>(args)...);
+        buf.push_back('\n');
+        detail::log_write(buf);
+    }
+#endif
+
+    /**
+     * @brief Severity of a levelled message.
+     */
+    enum class log_level : uint8_t {
+        trace,
+        debug,
+        info,
+        warn,
+        error,
+        off,
+    };
+
+    /**
+     * @brief Lowest level that is compiled in, set through NAO_LOG_MIN_LEVEL.
+     */
+    inline constexpr log_level min_log_level = static_cast<log_level>(NAO_LOG_MIN_LEVEL);
+
+    /**
+     * @brief Sets the lowest level that is logged, for all categories without their own level.
+     * @note The default is log_level::info.
+     */
+    void set_log_level(log_level level);
+
+    /**
+     * @brief Sets the lowest level that is logged for the category named `category`.
+     * @note Also applies to categories with that name that are created later.
+     */
+    void set_log_level(std::string_view category, log_level level);
+
+    /**
+     * @brief Makes the category named `category` follow the global level again.
+     */
+    void reset_log_level(std::string_view category);
+
+    /**
+     * @return The global level.
+     */
+    log_level get_log_level();
+
+    /**
+     * @brief Named subsystem with its own runtime level, meant to be declared once
+     *          per subsystem with static storage duration.
+     */
+    class log_category {
+        std::string _name;
+        std::atomic<log_level> _level;
+
+        // Managed by the category registry
+        bool _overridden = false;
+        friend class log_category_registry;
+
+        public:
+        log_category(const log_category&) = delete;
+        log_category& operator=(const log_category&) = delete;
+
+        explicit log_category(std::string_view name);
+        ~log_category();
+
+        std::string_view name() const {
+            return _name;
+        }
+
+        /**
+         * @return Whether messages of `level` are currently logged.
+         */
+        bool enabled(log_level level) const {
+            return level >= _level.load(std::memory_order_relaxed);
+        }
+    };
+
+    namespace detail {
+        extern std::atomic<log_level> log_threshold;
+
+        constexpr std::string_view level_name(log_level level) {
+            switch (level) {
+                case log_level::trace: return "trace";
+                case log_level::debug: return "debug";
+                case log_level::info:  return "info";
+                case log_level::warn:  return "warn";
+                case log_level::error: return "error";
+                default:               return "off";
+            }
+        }
+
+        template <typename T>
+        concept log_category_arg = std::derived_from<std::remove_cvref_t<T>, log_category>;
+
+        /**
+         * @brief Formats a levelled message as `[level] [category] args...` followed by a newline.
+         */
+        template <typename... Args>
+        void log_line(log_level level, std::string_view category, const Args&... args) {
+            std::string& buf = detail::log_buffer();
+            buf.clear();
+            buf.append("[").append(level_name(level)).append("] ");
+            if (!category.empty()) {
+                buf.append("[").append(category).append("] ");
+            }
+
+            log_format(buf, args...);
+            buf.push_back('\n');
+            log_write(buf);
+        }
+    }
+
+    /**
+     * @brief Logs a message at `Level`, in the given category.
+     * @note Compiles to nothing below min_log_level, and below the category's
+     *          runtime level nothing is formatted.
+     */
+    template <log_level Level, typename... Args>
+    void log(const log_category& category, const Args&... args) {
+        if constexpr (Level >= min_log_level) {
+            if (category.enabled(Level)) {
+                detail::log_line(Level, category.name(), args...);
+            }
+        }
+    }
+
+    /**
+     * @brief Logs a message at `Level`, filtered by the global level.
+     */
+    template <log_level Level, typename First, typename... Args>
+        requires (!detail::log_category_arg<First>)
+    void log(const First& first, const Args&... args) {
+        if constexpr (Level >= min_log_level) {
+            if (Level >= detail::log_threshold.load(std::memory_order_relaxed)) {
+                detail::log_line(Level, {}, first, args...);
+            }
+        }
+    }
+
+    template <typename... Args>
+    void trace(const Args&... args) {
+        log<log_level::trace>(args...);
+    }
+
+    template <typename... Args>
+    void debug(const Args&... args) {
+        log<log_level::debug>(args...);
+    }
+
+    template <typename... Args>
+    void info(const Args&... args) {
+        log<log_level::info>(args...);
+    }
+
+    template <typename... Args>
+    void warn(const Args&... args) {
+        log<log_level::warn>(args...);
+    }
+
+    template <typename... Args>
+    void error(const Args&... args) {
+        log<log_level::error>(args...);
+    }
 }
@@ -0,0 +1,62 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+namespace nao {
+    /**
+     * @brief Read-only memory mapping of an entire file.
+     * @note Pages are loaded on first access, so mapping a large file is cheap
+     *          and only the parts that are read take up memory.
+     */
+    class mapped_file {
+        const char* _data = nullptr;
+        size_t _size = 0;
+
+        public:
+        mapped_file() = default;
+
+        /**
+         * @brief Maps the file at `path`, throws std::runtime_error if that fails.
+         * @note Empty files are not mapped, data() is nullptr for them.
+         */
+        explicit mapped_file(const std::filesystem::path& path);
+        ~mapped_file();
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        mapped_file(mapped_file&& other) noexcept;
+        mapped_file& operator=(mapped_file&& other) noexcept;
+
+        [[nodiscard]] const char* data() const noexcept { return _data; }
+        [[nodiscard]] size_t size() const noexcept { return _size; }
+        [[nodiscard]] bool empty() const noexcept { return _size == 0; }
+
+        [[nodiscard]] const char* begin() const noexcept { return _data; }
+        [[nodiscard]] const char* end() const noexcept { return _data + _size; }
+
+        [[nodiscard]] std::string_view view() const noexcept { return { _data, _size }; }
+
+        /**
+         * @brief Unmaps the file, leaving an empty mapping.
+         */
+        void close() noexcept;
+    };
+}
@@ -0,0 +1,108 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace nao {
+    /**
+     * @brief Settings for a progress meter.
+     */
+    struct progress_options {
+        // Printed at the start of every line
+        std::string label;
+
+        // Time between printed lines
+        std::chrono::milliseconds interval { 1000 };
+
+        // Time constant of the rate average, longer reacts slower but fluctuates less
+        std::chrono::milliseconds smoothing { 5000 };
+    };
+
+    /**
+     * @brief Tracks the progress of a transfer that any number of threads add to,
+     *          and periodically prints its size, rate, percentage and ETA through nao::cout.
+     */
+    class progress {
+        // Only written by workers, kept apart from what the reporter touches
+        alignas(64) std::atomic<uint64_t> _done { 0 };
+
+        alignas(64) std::atomic<uint64_t> _total;
+        progress_options _options;
+
+        // Bytes per second, exponentially weighted
+        std::atomic<double> _rate { 0. };
+
+        std::mutex _mutex;
+        std::condition_variable _cv;
+        bool _stop = false;
+        std::thread _reporter;
+
+        void _report_func();
+        std::string _line(uint64_t done, uint64_t total, double rate) const;
+
+        public:
+        /**
+         * @param total - Expected number of bytes, 0 if unknown.
+         */
+        explicit progress(uint64_t total = 0, progress_options options = {});
+
+        /**
+         * @brief Calls finish().
+         */
+        ~progress();
+
+        progress(const progress&) = delete;
+        progress& operator=(const progress&) = delete;
+
+        /**
+         * @brief Adds `n` processed bytes. Safe to call from any thread, and costs a
+         *          single relaxed atomic add.
+         */
+        void add(uint64_t n) noexcept {
+            _done.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Changes the expected number of bytes, 0 if unknown.
+         */
+        void set_total(uint64_t total) noexcept;
+
+        [[nodiscard]] uint64_t done() const noexcept;
+        [[nodiscard]] uint64_t total() const noexcept;
+
+        /**
+         * @return The smoothed rate in bytes per second, as of the last update.
+         */
+        [[nodiscard]] double rate() const noexcept;
+
+        /**
+         * @return The line that would be printed for the current state, without a newline.
+         */
+        [[nodiscard]] std::string line() const;
+
+        /**
+         * @brief Stops reporting and prints a final line. Only the first call has an effect.
+         */
+        void finish();
+    };
+}
@@ -15,7 +15,15 @@
 
 #pragma once
 
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <string>
+#include <string_view>
+
+#if __has_include(<format>)
+#include <format>
+#endif
 
 namespace nao {
     /**
@@ -47,13 +55,586 @@ namespace nao {
      */
     std::string time_minutes(uint64_t nanoseconds, bool add_ms = true);
 
+    /**
+     * @brief A byte count, formatted like bytes().
+     */
+    struct byte_size {
+        size_t count;
+    };
+
+    /**
+     * @brief A bit count, formatted like bits().
+     */
+    struct bit_size {
+        size_t count;
+    };
+
+    /**
+     * @brief Prefixes a count is scaled with.
+     */
+    enum class unit_system : uint8_t {
+        iec,    // Powers of 1024: Ki, Mi, Gi, ...
+        si,     // Powers of 1000: k, M, G, ...
+    };
+
+    /**
+     * @brief How a count is scaled to the largest prefix it reaches, and printed.
+     *
+     * The result is "<value> <prefix><unit>", or "<count> <unscaled>" below the first prefix.
+     * Rounding is half to even, and a value that rounds up to the next prefix uses that prefix.
+     */
+    struct unit_format {
+        std::string_view unit;
+        std::string_view unscaled = unit;
+        unit_system system = unit_system::iec;
+
+        // Number of decimals, at most 9
+        uint8_t decimals = 3;
+
+        // If non-zero, the number of significant digits instead, never less than the integer part
+        uint8_t significant = 0;
+
+        // Remove trailing zeroes, and the decimal point if nothing is left after it
+        bool trim = true;
+    };
+
+    inline constexpr unit_format iec_bytes { "B", "bytes" };
+    inline constexpr unit_format iec_bits { "bit", "bits" };
+    inline constexpr unit_format si_bytes { "B", "bytes", unit_system::si };
+    inline constexpr unit_format si_bits { "bit", "bits", unit_system::si };
+    inline constexpr unit_format iec_byte_rate { "B/s" };
+    inline constexpr unit_format si_bit_rate { "bit/s", "bit/s", unit_system::si };
+
+    /**
+     * @brief A count formatted according to a unit_format.
+     * @note Unit names longer than a few characters may not fit in to_inline_string.
+     */
+    struct unit_value {
+        uint64_t count;
+        unit_format format;
+    };
+
+    /**
+     * @brief A fraction, formatted like percent().
+     */
+    struct percentage {
+        double fraction;
+    };
+
+    /**
+     * @brief Fields of a formatted duration.
+     */
+    enum class time_unit : uint8_t {
+        days,
+        hours,
+        minutes,
+        seconds,
+    };
+
+    /**
+     * @brief Layout of a formatted duration, "[<d>d ][hh:][mm:]ss[.fff]".
+     */
+    struct duration_format {
+        // First field printed, which is not limited to its usual range and not zero-padded
+        time_unit largest = time_unit::hours;
+
+        // Digits of the fraction of a second, 0 to 9. The fraction is truncated, not rounded.
+        uint8_t decimals = 3;
+    };
+
+    /**
+     * @brief A duration in nanoseconds, formatted like time_hours() or time_minutes().
+     */
+    struct clock_time {
+        uint64_t nanoseconds;
+        duration_format format {};
+    };
+
+    /**
+     * @brief Upper bound on the length of any value formatted by the overloads below.
+     */
+    inline constexpr size_t formatted_size_max = 32;
+
+    /**
+     * @brief Formats `value` into [first, last) without allocating, like std::to_chars.
+     * @return Past the end of the written characters, or `last` and
+     *          std::errc::value_too_large if the range is too small.
+     */
+    std::to_chars_result to_chars(char* first, char* last, byte_size value);
+    std::to_chars_result to_chars(char* first, char* last, bit_size value);
+    std::to_chars_result to_chars(char* first, char* last, unit_value value);
+    std::to_chars_result to_chars(char* first, char* last, percentage value);
+    std::to_chars_result to_chars(char* first, char* last, clock_time value);
+
+    /**
+     * @brief A string stored inline, for short results that should not allocate.
+     */
+    template <size_t Capacity>
+    class inline_string {
+        char _data[Capacity + 1] {};
+        size_t _size = 0;
+
+        public:
+        constexpr inline_string() = default;
+
+        /**
+         * @note `str` is cut off at Capacity characters.
+         */
+        constexpr inline_string(std::string_view str) : _size { std::min(str.size(), Capacity) } {
+            std::copy_n(str.data(), _size, _data);
+        }
+
+        [[nodiscard]] constexpr const char* data() const { return _data; }
+        [[nodiscard]] constexpr const char* c_str() const { return _data; }
+        [[nodiscard]] constexpr size_t size() const { return _size; }
+        [[nodiscard]] constexpr bool empty() const { return _size == 0; }
+        [[nodiscard]] constexpr const char* begin() const { return _data; }
+        [[nodiscard]] constexpr const char* end() const { return _data + _size; }
+
+        [[nodiscard]] constexpr std::string_view view() const { return { _data, _size }; }
+        constexpr operator std::string_view() const { return view(); }
+    };
+
+    /**
+     * @brief Formats `value` into an inline_string, without touching the heap.
+     * @note The result is empty if it does not fit.
+     */
+    template <typename T>
+    inline_string<formatted_size_max> to_inline_string(T value) {
+        char buf[formatted_size_max];
+        auto res = to_chars(buf, buf + formatted_size_max, value);
+        if (res.ec != std::errc {}) {
+            return {};
+        }
+
+        return std::string_view { buf, static_cast<size_t>(res.ptr - buf) };
+    }
+
+    /**
+     * @brief Appends `value` as formatted by to_chars to any string type, such as a nao::arena_string.
+     */
+    template <typename String, typename T>
+    void append_formatted(String& out, T value) {
+        auto str = to_inline_string(value);
+        out.append(str.data(), str.size());
+    }
+
+    /**
+     * @brief Formats `n` according to `format`.
+     */
+    std::string format_units(uint64_t n, const unit_format& format);
+
+    namespace detail {
+        inline constexpr uint64_t seconds_per[] { 86400, 3600, 60, 1 };
+
+        // Range of each field when it is not the largest one
+        inline constexpr uint64_t field_range[] { 0, 24, 60, 60 };
+
+        inline constexpr uint64_t nanoseconds_per_second = 1'000'000'000;
+
+        constexpr uint64_t pow10(int n) {
+            uint64_t res = 1;
+            while (n-- > 0) {
+                res *= 10;
+            }
+
+            return res;
+        }
+
+        /**
+         * @brief Writes `v` with at least `width` digits, padded with zeroes.
+         */
+        constexpr char* write_digits(char* out, uint64_t v, int width) {
+            char digits[20] {};
+            int count = 0;
+            do {
+                digits[count++] = static_cast<char>('0' + (v % 10));
+                v /= 10;
+            } while (v > 0);
+
+            while (count < width) {
+                digits[count++] = '0';
+            }
+
+            while (count > 0) {
+                *out++ = digits[--count];
+            }
+
+            return out;
+        }
+
+        constexpr bool is_digit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        /**
+         * @brief Reads exactly 2 digits.
+         */
+        constexpr bool read_2_digits(const char*& p, const char* last, uint64_t& v) {
+            if (last - p < 2 || !is_digit(p[0]) || !is_digit(p[1])) {
+                return false;
+            }
+
+            v = static_cast<uint64_t>(p[0] - '0') * 10 + static_cast<uint64_t>(p[1] - '0');
+            p += 2;
+            return true;
+        }
+
+        constexpr bool checked_mul_add(uint64_t& v, uint64_t mul, uint64_t add) {
+            if (v > (~uint64_t { 0 } - add) / mul) {
+                return false;
+            }
+
+            v = v * mul + add;
+            return true;
+        }
+    }
+
+    /**
+     * @brief Formats a duration into [first, last) without allocating, like std::to_chars.
+     */
+    constexpr std::to_chars_result format_duration(char* first, char* last,
+        uint64_t nanoseconds, duration_format format = {}) {
+        char buf[formatted_size_max] {};
+        char* out = buf;
+
+        uint64_t seconds = nanoseconds / detail::nanoseconds_per_second;
+        auto largest = static_cast<size_t>(format.largest);
+
+        for (size_t field = largest; field < std::size(detail::seconds_per); ++field) {
+            uint64_t value = seconds / detail::seconds_per[field];
+            if (field == largest) {
+                out = detail::write_digits(out, value, 1);
+            } else {
+                if (field - 1 != static_cast<size_t>(time_unit::days)) {
+                    *out++ = ':';
+                }
+
+                out = detail::write_digits(out, value % detail::field_range[field], 2);
+            }
+
+            if (field == static_cast<size_t>(time_unit::days)) {
+                *out++ = 'd';
+                *out++ = ' ';
+            }
+        }
+
+        int decimals = std::min<int>(format.decimals, 9);
+        if (decimals > 0) {
+            uint64_t fraction = nanoseconds % detail::nanoseconds_per_second;
+            *out++ = '.';
+            out = detail::write_digits(out, fraction / detail::pow10(9 - decimals), decimals);
+        }
+
+        auto size = out - buf;
+        if (last - first < size) {
+            return { last, std::errc::value_too_large };
+        }
+
+        std::copy_n(buf, size, first);
+        return { first + size, std::errc {} };
+    }
+
+    /**
+     * @brief Parses a duration in any layout format_duration produces, like std::from_chars.
+     *
+     * Accepts "[<d>d hh:mm:ss|[[h:]m:]s][.f]": without days, one to three fields of which
+     * all but the first have 2 digits, and a fraction of any length, of which digits
+     * below nanoseconds are ignored.
+     *
+     * @return Past the parsed characters. On invalid input `first` and std::errc::invalid_argument,
+     *          or std::errc::result_out_of_range if the duration does not fit in 64 bits.
+     */
+    constexpr std::from_chars_result parse_duration(const char* first, const char* last, uint64_t& nanoseconds) {
+        const char* p = first;
+        std::from_chars_result invalid { first, std::errc::invalid_argument };
+
+        uint64_t leading = 0;
+        bool overflow = false;
+        if (p == last || !detail::is_digit(*p)) {
+            return invalid;
+        }
+
+        for (; p != last && detail::is_digit(*p); ++p) {
+            overflow |= !detail::checked_mul_add(leading, 10, static_cast<uint64_t>(*p - '0'));
+        }
+
+        // Fields from the largest one parsed down to seconds
+        uint64_t fields[4] {};
+        size_t count = 0;
+
+        if (p != last && *p == 'd') {
+            if (last - p < 2 || p[1] != ' ') {
+                return invalid;
+            }
+
+            p += 2;
+            fields[count++] = leading;
+
+            for (size_t field = 1; field < 4; ++field) {
+                if (field > 1 && (p == last || *p++ != ':')) {
+                    return invalid;
+                }
+
+                if (!detail::read_2_digits(p, last, fields[count]) || fields[count] >= detail::field_range[field]) {
+                    return invalid;
+                }
+
+                ++count;
+            }
+        } else {
+            fields[count++] = leading;
+            while (count < 3 && p != last && *p == ':') {
+                ++p;
+                if (!detail::read_2_digits(p, last, fields[count]) || fields[count] >= 60) {
+                    return invalid;
+                }
+
+                ++count;
+            }
+        }
+
+        uint64_t fraction = 0;
+        if (p != last && *p == '.') {
+            ++p;
+            int digits = 0;
+            for (; p != last && detail::is_digit(*p); ++p, ++digits) {
+                if (digits < 9) {
+                    fraction = fraction * 10 + static_cast<uint64_t>(*p - '0');
+                }
+            }
+
+            if (digits == 0) {
+                return invalid;
+            }
+
+            fraction *= detail::pow10(9 - std::min(digits, 9));
+        }
+
+        // The last field is always seconds, fold the others into it
+        uint64_t result = fields[0];
+        for (size_t i = 1, field = std::size(detail::seconds_per) - count + 1; i < count; ++i, ++field) {
+            uint64_t per_larger = detail::seconds_per[field - 1] / detail::seconds_per[field];
+            overflow |= !detail::checked_mul_add(result, per_larger, fields[i]);
+        }
+
+        overflow |= !detail::checked_mul_add(result, detail::nanoseconds_per_second, fraction);
+        if (overflow) {
+            return { p, std::errc::result_out_of_range };
+        }
+
+        nanoseconds = result;
+        return { p, std::errc {} };
+    }
+
     /**
      * @brief Converts a UTF-8 encoded string_view to a UTF-16 encoded string.
+     * @note Throws std::runtime_error on invalid UTF-8 (overlong forms, surrogates,
+     *          truncated sequences or code points above U+10FFFF).
+     * @note Where wchar_t is 32 bits wide each element still holds one UTF-16 unit.
      */
     std::wstring to_utf16(std::string_view str);
 
+    /**
+     * @brief Portable version of to_utf16.
+     */
+    std::u16string to_u16string(std::string_view str);
+
     /**
      * @brief Converts a UTF-16 encoded string_view to a UTF-8 encoded string.
+     * @note Unpaired surrogates are replaced by U+FFFD. Where wchar_t is 32 bits
+     *          wide, elements above 0xFFFF are taken to be UTF-32 code points.
      */
     std::string to_utf8(std::wstring_view str);
+
+    /**
+     * @brief Portable version of to_utf8.
+     */
+    std::string to_utf8(std::u16string_view str);
+
+    /**
+     * @brief Largest number of UTF-16 units produced from `utf8_size` bytes of UTF-8.
+     */
+    constexpr size_t utf16_length_bound(size_t utf8_size) {
+        return utf8_size;
+    }
+
+    /**
+     * @brief Largest number of UTF-8 bytes produced from `units` elements of `CharT`.
+     * @note A 32-bit wchar_t element may hold a UTF-32 code point, which takes 4 bytes.
+     */
+    template <typename CharT = char16_t>
+    constexpr size_t utf8_length_bound(size_t units) {
+        return units * (sizeof(CharT) == 2 ? 3 : 4);
+    }
+
+    /**
+     * @brief Converts UTF-8 into a caller-provided buffer.
+     * @param out - Must hold at least utf16_length_bound(str.size()) elements.
+     * @return The number of elements written.
+     * @note Throws std::runtime_error on invalid UTF-8, `out` may have been written to.
+     */
+    size_t to_utf16(std::string_view str, wchar_t* out);
+    size_t to_utf16(std::string_view str, char16_t* out);
+
+    /**
+     * @brief Converts UTF-16 into a caller-provided buffer.
+     * @param out - Must hold at least utf8_length_bound<CharT>(str.size()) bytes.
+     * @return The number of bytes written.
+     */
+    size_t to_utf8(std::wstring_view str, char* out);
+    size_t to_utf8(std::u16string_view str, char* out);
+
+    /**
+     * @brief Appends the UTF-16 conversion of `str` to `dst`, reusing its capacity.
+     * @note Throws std::runtime_error on invalid UTF-8, `dst` is left unchanged.
+     */
+    void append_utf16(std::wstring& dst, std::string_view str);
+    void append_utf16(std::u16string& dst, std::string_view str);
+
+    /**
+     * @brief Appends the UTF-8 conversion of `str` to `dst`, reusing its capacity.
+     */
+    void append_utf8(std::string& dst, std::wstring_view str);
+    void append_utf8(std::string& dst, std::u16string_view str);
+
+    /**
+     * @brief Finds the first invalid sequence in `str`, without converting anything.
+     * @return The offset of the sequence, or std::string_view::npos if `str` is valid UTF-8.
+     * @note Rejects the same input as to_utf16.
+     */
+    size_t validate_utf8(std::string_view str);
+
+    /**
+     * @brief Largest number of UTF-32 units produced from `utf8_size` bytes of UTF-8.
+     */
+    constexpr size_t utf32_length_bound(size_t utf8_size) {
+        return utf8_size;
+    }
+
+    /**
+     * @brief Converts a UTF-8 encoded string_view to a UTF-32 encoded string.
+     * @note Throws std::runtime_error on invalid UTF-8.
+     */
+    std::u32string to_utf32(std::string_view str);
+
+    /**
+     * @brief Converts UTF-8 into a caller-provided buffer.
+     * @param out - Must hold at least utf32_length_bound(str.size()) elements.
+     * @return The number of elements written.
+     */
+    size_t to_utf32(std::string_view str, char32_t* out);
+
+    /**
+     * @brief Appends the UTF-32 conversion of `str` to `dst`.
+     * @note Throws std::runtime_error on invalid UTF-8, `dst` is left unchanged.
+     */
+    void append_utf32(std::u32string& dst, std::string_view str);
+
+    /**
+     * @brief Converts a UTF-32 encoded string_view to a UTF-8 encoded string.
+     * @note Surrogates and values above U+10FFFF are replaced by U+FFFD.
+     */
+    std::string to_utf8(std::u32string_view str);
+    size_t to_utf8(std::u32string_view str, char* out);
+    void append_utf8(std::string& dst, std::u32string_view str);
+
+    /**
+     * @brief Converts a Latin-1 (ISO-8859-1) encoded string_view to UTF-8.
+     */
+    std::string latin1_to_utf8(std::string_view str);
+
+    /**
+     * @brief Converts a UTF-8 encoded string_view to Latin-1.
+     * @note Throws std::runtime_error on invalid UTF-8 or characters above U+00FF.
+     */
+    std::string utf8_to_latin1(std::string_view str);
+
+    /**
+     * @brief Incremental UTF-8 to UTF-16 conversion of input that arrives in chunks.
+     *
+     * Chunks may split a sequence anywhere, the partial sequence is held
+     * until the next chunk completes it.
+     */
+    class utf8_to_utf16_stream {
+        char _pending[4] {};
+        size_t _pending_size = 0;
+
+        public:
+        /**
+         * @brief Converts `chunk` and appends the result to `out`.
+         * @note Throws std::runtime_error on invalid UTF-8, after which the stream
+         *          should be discarded.
+         */
+        void feed(std::string_view chunk, std::wstring& out);
+        void feed(std::string_view chunk, std::u16string& out);
+
+        /**
+         * @brief Ends the input.
+         * @note Throws std::runtime_error if it ended in the middle of a sequence.
+         */
+        void finish();
+    };
+
+    /**
+     * @brief Incremental UTF-16 to UTF-8 conversion of input that arrives in chunks.
+     *
+     * A surrogate pair split across chunks is joined, unpaired surrogates
+     * are replaced by U+FFFD as in to_utf8.
+     */
+    class utf16_to_utf8_stream {
+        char32_t _pending = 0;
+
+        public:
+        /**
+         * @brief Converts `chunk` and appends the result to `out`.
+         */
+        void feed(std::wstring_view chunk, std::string& out);
+        void feed(std::u16string_view chunk, std::string& out);
+
+        /**
+         * @brief Ends the input, flushing a trailing unpaired surrogate to `out`.
+         */
+        void finish(std::string& out);
+    };
+}
+
+#ifdef __cpp_lib_format
+namespace nao::detail {
+    /**
+     * @brief Formats a value through nao::to_chars, no format specifiers are accepted.
+     */
+    template <typename T>
+    struct value_formatter {
+        constexpr auto parse(std::format_parse_context& ctx) {
+            auto it = ctx.begin();
+            if (it != ctx.end() && *it != '}') {
+                throw std::format_error("format specifiers are not supported");
+            }
+
+            return it;
+        }
+
+        template <typename FormatContext>
+        auto format(const T& value, FormatContext& ctx) const {
+            auto str = nao::to_inline_string(value);
+            return std::copy(str.begin(), str.end(), ctx.out());
+        }
+    };
 }
+
+template <>
+struct std::formatter<nao::byte_size> : nao::detail::value_formatter<nao::byte_size> { };
+
+template <>
+struct std::formatter<nao::bit_size> : nao::detail::value_formatter<nao::bit_size> { };
+
+template <>
+struct std::formatter<nao::unit_value> : nao::detail::value_formatter<nao::unit_value> { };
+
+template <>
+struct std::formatter<nao::percentage> : nao::detail::value_formatter<nao::percentage> { };
+
+template <>
+struct std::formatter<nao::clock_time> : nao::detail::value_formatter<nao::clock_time> { };
+#endif
@@ -0,0 +1,278 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#pragma once
+
+#include "nao/arena.h"
+#include "nao/intern.h"
+#include "nao/mapped_file.h"
+
+#include <vdf_parser.h>
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * VDF trees backed by nao's allocators, read with tyti::vdf::read and tyti::vdf::parse
+ */
+
+namespace nao {
+    namespace vdf {
+        /**
+         * @brief Object whose strings and maps are allocated from nao::current_resource().
+         *
+         * Reading with a nao::resource_scope for a nao::arena puts the tree's contents
+         * in the arena, to be freed at once. The nodes themselves are still allocated
+         * individually.
+         */
+        template <typename CharT>
+        struct basic_pmr_object {
+            using char_type = CharT;
+            using string_type = std::pmr::basic_string<char_type>;
+
+            string_type name;
+            std::pmr::unordered_map<string_type, string_type> attribs;
+            std::pmr::unordered_map<string_type, std::shared_ptr<basic_pmr_object<char_type>>> childs;
+
+            basic_pmr_object() : basic_pmr_object { current_resource() } { }
+            explicit basic_pmr_object(std::pmr::memory_resource* resource)
+                : name { resource }, attribs { resource }, childs { resource } { }
+
+            // Views, so that strings are only ever constructed with the object's allocator
+            void add_attribute(std::basic_string_view<char_type> key, std::basic_string_view<char_type> value) {
+                attribs.emplace(key, value);
+            }
+
+            void add_child(std::unique_ptr<basic_pmr_object<char_type>> child) {
+                std::shared_ptr<basic_pmr_object<char_type>> obj { child.release() };
+                childs.emplace(obj->name, obj);
+            }
+
+            void set_name(std::basic_string_view<char_type> n) {
+                name.assign(n);
+            }
+        };
+
+        using pmr_object = basic_pmr_object<char>;
+        using wpmr_object = basic_pmr_object<wchar_t>;
+
+        /**
+         * @brief Object whose names and keys are interned in nao::default_intern_pool().
+         *
+         * Key names repeat across nodes and files, so they are stored once and compare as pointers.
+         */
+        struct interned_object {
+            using char_type = char;
+
+            interned name;
+            std::unordered_map<interned, std::string> attribs;
+            std::unordered_map<interned, std::shared_ptr<interned_object>> childs;
+
+            void add_attribute(std::string_view key, std::string_view value) {
+                attribs.emplace(intern(key), value);
+            }
+
+            void add_child(std::unique_ptr<interned_object> child) {
+                std::shared_ptr<interned_object> obj { child.release() };
+                childs.emplace(obj->name, obj);
+            }
+
+            void set_name(std::string_view n) {
+                name = intern(n);
+            }
+        };
+
+        /**
+         * @brief Node of a document, only valid as long as the document.
+         */
+        struct view_object {
+            using char_type = char;
+
+            std::string_view name;
+            std::pmr::unordered_map<std::string_view, std::string_view> attribs;
+            std::pmr::unordered_map<std::string_view, const view_object*> childs;
+
+            explicit view_object(std::pmr::memory_resource* resource)
+                : attribs { resource }, childs { resource } { }
+        };
+
+        /**
+         * @brief Read-only VDF tree that refers to its text instead of copying it.
+         *
+         * Keys and values are views into the text, only those containing escape sequences
+         * are unescaped into copies. Those copies and all nodes are allocated from one
+         * nao::arena, so the document is freed at once.
+         */
+        class document {
+            std::unique_ptr<arena> _arena;
+            std::vector<mapped_file> _files;
+            const view_object* _root;
+
+            public:
+            /**
+             * @brief Empty document.
+             */
+            document() : _arena { std::make_unique<arena>() }, _root { _new_object() } { }
+
+            /**
+             * @brief Memory maps the file at `path` and parses it, as well as any files it includes.
+             * @throws std::runtime_error if a file can't be mapped or a parsing error occured
+             */
+            explicit document(const std::filesystem::path& path) : _arena { std::make_unique<arena>() } {
+                std::unordered_set<std::string> exclude_files;
+                _root = _parse(_map(path), exclude_files);
+            }
+
+            /**
+             * @brief Parses VDF text, which has to outlive the document.
+             * @throws std::runtime_error if a parsing error occured
+             */
+            explicit document(std::string_view text) : _arena { std::make_unique<arena>() } {
+                std::unordered_set<std::string> exclude_files;
+                _root = _parse(text, exclude_files);
+            }
+
+            [[nodiscard]] const view_object& root() const noexcept { return *_root; }
+            const view_object* operator->() const noexcept { return _root; }
+
+            /**
+             * @return Bytes taken by the nodes and unescaped strings, the text itself is not included.
+             */
+            [[nodiscard]] size_t memory_used() const noexcept { return _arena->reserved(); }
+
+            private:
+            view_object* _new_object() {
+                std::pmr::polymorphic_allocator<view_object> alloc { _arena.get() };
+                return alloc.new_object<view_object>(_arena.get());
+            }
+
+            std::string_view _map(const std::filesystem::path& path) {
+                _files.emplace_back(path);
+                return _files.back().view();
+            }
+
+            // Builds the nodes of one text, included texts get their own builder like in tyti::vdf::read
+            class builder {
+                document& _doc;
+                std::string_view _text;
+                std::unordered_set<std::string>& _exclude_files;
+
+                view_object* _cur = nullptr;
+                std::vector<view_object*> _lvls;
+                std::vector<view_object*> _roots;
+
+                public:
+                builder(document& doc, std::string_view text, std::unordered_set<std::string>& exclude_files)
+                    : _doc { doc }, _text { text }, _exclude_files { exclude_files } { }
+
+                /**
+                 * @return Objects closed at the top level, objects that are never closed are dropped.
+                 */
+                const std::vector<view_object*>& parse() {
+                    tyti::vdf::parse(_text.begin(), _text.end(), *this);
+                    return _roots;
+                }
+
+                bool on_object_begin(std::string_view name) {
+                    if (_cur) {
+                        _lvls.push_back(_cur);
+                    }
+
+                    _cur = _doc._new_object();
+                    _cur->name = _keep(name);
+                    return true;
+                }
+
+                bool on_key_value(std::string_view key, std::string_view value) {
+                    if (!tyti::vdf::detail::is_include(key)) {
+                        if (!_cur) {
+                            throw std::runtime_error { "attribute outside of an object" };
+                        }
+
+                        _cur->attribs.try_emplace(_keep(key), _keep(value));
+                        return true;
+                    }
+
+                    std::string file { value };
+                    if (_exclude_files.insert(file).second) {
+                        builder included { _doc, _doc._map(file), _exclude_files };
+                        for (view_object* n : included.parse()) {
+                            if (_cur) {
+                                _cur->childs.try_emplace(n->name, n);
+                            } else {
+                                _roots.push_back(n);
+                            }
+                        }
+
+                        _exclude_files.erase(file);
+                    }
+
+                    return true;
+                }
+
+                bool on_object_end() {
+                    if (!_lvls.empty()) {
+                        view_object* prev = _lvls.back();
+                        _lvls.pop_back();
+                        prev->childs.try_emplace(_cur->name, _cur);
+                        _cur = prev;
+                    } else {
+                        _roots.push_back(_cur);
+                        _cur = nullptr;
+                    }
+
+                    return true;
+                }
+
+                private:
+                // Views into the text are kept as they are, unescaped ones are copied into the arena
+                std::string_view _keep(std::string_view str) {
+                    std::less<const char*> less;
+                    if (!less(str.data(), _text.data()) && !less(_text.data() + _text.size(), str.data() + str.size())) {
+                        return str;
+                    }
+
+                    auto copy = static_cast<char*>(_doc._arena->allocate(str.size(), 1));
+                    std::copy(str.begin(), str.end(), copy);
+                    return { copy, str.size() };
+                }
+            };
+
+            // Parses the text into nodes, combining several roots like tyti::vdf::read does
+            const view_object* _parse(std::string_view text, std::unordered_set<std::string>& exclude_files) {
+                builder b { *this, text, exclude_files };
+                const auto& roots = b.parse();
+
+                if (roots.size() == 1) {
+                    return roots.front();
+                }
+
+                view_object* result = _new_object();
+                for (view_object* root : roots) {
+                    result->childs.try_emplace(root->name, root);
+                }
+
+                return result;
+            }
+        };
+    }
+}
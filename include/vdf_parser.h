@@ -26,6 +26,7 @@
 #include <vector>
 #include <unordered_map>
 #include <utility>
+#include <cstdint>
 #include <fstream>
 #include <memory>
 #include <unordered_set>
@@ -33,15 +34,35 @@
 
 #include <system_error>
 #include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <iterator>
 
 //for wstring support
 #include <locale>
 #include <string>
+#include <string_view>
 
 // internal
 #include <stack>
 
 
+// vectorized tokenizer, define TYTI_VDF_NO_SIMD to scan one character at a time
+#include <bit>
+#ifndef TYTI_VDF_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TYTI_VDF_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TYTI_VDF_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TYTI_VDF_NEON
+#endif
+#endif
+
+
 //VS < 2015 has only partial C++11 support
 #if defined(_MSC_VER) && _MSC_VER < 1900
 #ifndef CONSTEXPR
@@ -213,6 +234,119 @@ namespace tyti
         typedef basic_multikey_object<char> multikey_object;
         typedef basic_multikey_object<wchar_t> wmultikey_object;
 
+        template<typename CharT>
+        class basic_flat_object;
+
+        namespace detail
+        {
+            template<typename CharT>
+            class flat_builder;
+        }
+
+        /** \brief Tree stored as one array of nodes, with all names, keys and values in one string.
+        Each node is either an object or an attribute, linked to its parent, first child and next
+        sibling by index. Children, attributes and objects alike, stay in the order of the text and
+        duplicate keys are all kept. Lookups by key are linear in the number of children.
+        */
+        template<typename CharT>
+        class basic_flat_object
+        {
+        public:
+            typedef CharT char_type;
+            typedef std::basic_string_view<char_type> string_view_type;
+            typedef uint32_t index_type;
+
+            /// no such node
+            static CONSTEXPR index_type npos = static_cast<index_type>(-1);
+
+            struct node
+            {
+                index_type parent = npos;
+                index_type first_child = npos;
+                index_type next_sibling = npos;
+
+                // key is the name for objects, value_size is npos for objects
+                index_type key_offset = 0;
+                index_type key_size = 0;
+                index_type value_offset = 0;
+                index_type value_size = npos;
+            };
+
+            /// index of the top level object, an unnamed one holding all of them if there are several
+            index_type root() const NOEXCEPT { return _root; }
+
+            /// number of nodes, including unreachable ones
+            size_t size() const NOEXCEPT { return _nodes.size(); }
+
+            const node& operator[](index_type i) const { return _nodes[i]; }
+
+            bool is_object(index_type i) const { return _nodes[i].value_size == npos; }
+            index_type parent(index_type i) const { return _nodes[i].parent; }
+            index_type first_child(index_type i) const { return _nodes[i].first_child; }
+            index_type next_sibling(index_type i) const { return _nodes[i].next_sibling; }
+
+            /// name of an object or key of an attribute
+            string_view_type key(index_type i) const
+            {
+                return { _pool.data() + _nodes[i].key_offset, _nodes[i].key_size };
+            }
+
+            /// value of an attribute, empty for objects
+            string_view_type value(index_type i) const
+            {
+                if (is_object(i))
+                    return {};
+                return { _pool.data() + _nodes[i].value_offset, _nodes[i].value_size };
+            }
+
+            string_view_type name() const { return key(_root); }
+
+            /// first child of `parent` with `key`, npos if there is none
+            index_type find(index_type parent, string_view_type key, bool object) const
+            {
+                for (index_type i = _nodes[parent].first_child; i != npos; i = _nodes[i].next_sibling)
+                {
+                    if (is_object(i) == object && this->key(i) == key)
+                        return i;
+                }
+                return npos;
+            }
+
+            index_type find_child(index_type parent, string_view_type name) const { return find(parent, name, true); }
+            index_type find_attribute(index_type parent, string_view_type key) const { return find(parent, key, false); }
+
+            /// value of the first attribute of `parent` with `key`, empty if there is none
+            string_view_type attribute(index_type parent, string_view_type key) const
+            {
+                index_type i = find_attribute(parent, key);
+                return i == npos ? string_view_type {} : value(i);
+            }
+
+            /// calls f(index) for each child of `parent`, in order
+            template<typename F>
+            void for_each_child(index_type parent, F&& f) const
+            {
+                for (index_type i = _nodes[parent].first_child; i != npos; i = _nodes[i].next_sibling)
+                    f(i);
+            }
+
+            /// bytes allocated for the nodes and strings
+            size_t memory_used() const NOEXCEPT
+            {
+                return _nodes.capacity() * sizeof(node) + _pool.capacity() * sizeof(char_type);
+            }
+
+        private:
+            friend class detail::flat_builder<CharT>;
+
+            std::vector<node> _nodes;
+            std::basic_string<char_type> _pool;
+            index_type _root = 0;
+        };
+
+        typedef basic_flat_object<char> flat_object;
+        typedef basic_flat_object<wchar_t> wflat_object;
+
         /** \brief writes given object tree in vdf format to given stream.
         Output is prettyfied, using tabs
         */
@@ -230,238 +364,1020 @@ namespace tyti
             s << tab << TYTI_L(charT, "}\n");
         }
 
+        template<typename oStreamT, typename CharT>
+        void write(oStreamT& s, const basic_flat_object<CharT>& r,
+            const detail::tabs<typename oStreamT::char_type> tab = detail::tabs<typename oStreamT::char_type>(0))
+        {
+            typedef typename oStreamT::char_type charT;
+            using namespace detail;
+            auto write_object = [&](auto& self, typename basic_flat_object<CharT>::index_type obj, const tabs<charT> t) -> void {
+                s << t << TYTI_L(charT, '"') << r.key(obj) << TYTI_L(charT, "\"\n") << t << TYTI_L(charT, "{\n");
+                r.for_each_child(obj, [&](auto i) {
+                    if (r.is_object(i))
+                        self(self, i, t + 1);
+                    else
+                        s << t + 1 << TYTI_L(charT, '"') << r.key(i) << TYTI_L(charT, "\"\t\t\"") << r.value(i) << TYTI_L(charT, "\"\n");
+                });
+                s << t << TYTI_L(charT, "}\n");
+            };
+            write_object(write_object, r.root(), tab);
+        }
+
         namespace detail
         {
+            /// characters read from a stream at once
+            CONSTEXPR size_t stream_chunk_size = 64 * 1024;
+
             template<typename iStreamT>
             std::basic_string<typename iStreamT::char_type> read_file(iStreamT& inStream)
             {
-                // cache the file
+                // cache the file, in chunks as the stream may not be seekable
                 typedef typename iStreamT::char_type charT;
                 std::basic_string<charT> str;
-                inStream.seekg(0, std::ios::end);
-                str.resize(static_cast<size_t>(inStream.tellg()));
-                if (str.empty())
-                    return str;
+                size_t size = 0;
+                do
+                {
+                    str.resize(size + stream_chunk_size);
+                    inStream.read(&str[size], stream_chunk_size);
+                    size += static_cast<size_t>(inStream.gcount());
+                } while (inStream);
+                str.resize(size);
+                return str;
+            }
+
+            /// key or value as it appears in the input, without the quotes around it
+            template<typename CharT>
+            struct token
+            {
+                std::basic_string_view<CharT> text;
+
+                // contains \" or \\, which unescape() replaces
+                bool escaped = false;
+            };
+
+            enum class token_type
+            {
+                key_value,      // key and value
+                object_begin,   // key is the name of the object
+                object_end,
+                end,
+                incomplete      // the text ends within a key/value, see tokenizer::partial
+            };
+
+            template<typename CharT>
+            CONSTEXPR bool is_whitespace(CharT c) NOEXCEPT
+            {
+                return c == ' ' || c == '\n' || c == '\v' || c == '\f' || c == '\r' || c == '\t';
+            }
+
+#if defined(TYTI_VDF_AVX2) || defined(TYTI_VDF_SSE2) || defined(TYTI_VDF_NEON)
+#define TYTI_VDF_SIMD
+            /** \brief A block of characters classified all at once, like simdjson does.
+            Each classification is a mask with `bits` bits per character, the first character being
+            the lowest, so that index() of a non zero mask is the first character that matched.
+            */
+            class simd_block
+            {
+#if defined(TYTI_VDF_AVX2)
+                __m256i _v;
+
+            public:
+                typedef uint32_t mask_type;
+                static CONSTEXPR size_t size = 32;
+                static CONSTEXPR int bits = 1;
+
+                explicit simd_block(const char* p) NOEXCEPT : _v(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))) {}
+
+                mask_type eq(char c) const NOEXCEPT
+                {
+                    return static_cast<mask_type>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_v, _mm256_set1_epi8(c))));
+                }
+
+                /// ' ' or '\t' to '\r', what is_whitespace() accepts
+                mask_type whitespace() const NOEXCEPT
+                {
+                    const __m256i ctrl = _mm256_sub_epi8(_v, _mm256_set1_epi8('\t'));
+                    const __m256i four = _mm256_set1_epi8(4);
+                    const __m256i is_ctrl = _mm256_cmpeq_epi8(_mm256_max_epu8(ctrl, four), four);
+                    return eq(' ') | static_cast<mask_type>(_mm256_movemask_epi8(is_ctrl));
+                }
+#elif defined(TYTI_VDF_SSE2)
+                __m128i _v;
+
+            public:
+                typedef uint32_t mask_type;
+                static CONSTEXPR size_t size = 16;
+                static CONSTEXPR int bits = 1;
+
+                explicit simd_block(const char* p) NOEXCEPT : _v(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+                mask_type eq(char c) const NOEXCEPT
+                {
+                    return static_cast<mask_type>(_mm_movemask_epi8(_mm_cmpeq_epi8(_v, _mm_set1_epi8(c))));
+                }
+
+                /// ' ' or '\t' to '\r', what is_whitespace() accepts
+                mask_type whitespace() const NOEXCEPT
+                {
+                    const __m128i ctrl = _mm_sub_epi8(_v, _mm_set1_epi8('\t'));
+                    const __m128i four = _mm_set1_epi8(4);
+                    const __m128i is_ctrl = _mm_cmpeq_epi8(_mm_max_epu8(ctrl, four), four);
+                    return eq(' ') | static_cast<mask_type>(_mm_movemask_epi8(is_ctrl));
+                }
+#else
+                uint8x16_t _v;
 
-                inStream.seekg(0, std::ios::beg);
-                inStream.read(&str[0], str.size());
+                // NEON has no movemask, narrowing leaves 4 bits per character
+                static uint64_t _mask(uint8x16_t m) NOEXCEPT
+                {
+                    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+                }
+
+            public:
+                typedef uint64_t mask_type;
+                static CONSTEXPR size_t size = 16;
+                static CONSTEXPR int bits = 4;
+
+                explicit simd_block(const char* p) NOEXCEPT : _v(vld1q_u8(reinterpret_cast<const uint8_t*>(p))) {}
+
+                mask_type eq(char c) const NOEXCEPT
+                {
+                    return _mask(vceqq_u8(_v, vdupq_n_u8(static_cast<uint8_t>(c))));
+                }
+
+                /// ' ' or '\t' to '\r', what is_whitespace() accepts
+                mask_type whitespace() const NOEXCEPT
+                {
+                    const uint8x16_t is_ctrl = vcleq_u8(vsubq_u8(_v, vdupq_n_u8('\t')), vdupq_n_u8(4));
+                    return _mask(vorrq_u8(vceqq_u8(_v, vdupq_n_u8(' ')), is_ctrl));
+                }
+#endif
+                /// all characters of the block
+                static CONSTEXPR mask_type all = static_cast<mask_type>(~mask_type { 0 } >> (sizeof(mask_type) * 8 - size * bits));
+
+                static size_t index(mask_type m) NOEXCEPT
+                {
+                    return static_cast<size_t>(std::countr_zero(m)) / bits;
+                }
+            };
+#endif
+
+            /** \brief Finds the first character in [first, last) for which `pred` is true.
+            Text of chars is classified a block at a time while `block_mask` of a simd_block is zero,
+            it has to match the same characters as `pred`.
+            */
+            template<typename CharT, typename PredT, typename MaskF>
+            const CharT* scan(const CharT* first, const CharT* last, PredT pred, MaskF block_mask) NOEXCEPT
+            {
+#ifdef TYTI_VDF_SIMD
+                if constexpr (std::is_same<CharT, char>::value)
+                {
+                    for (; static_cast<size_t>(last - first) >= simd_block::size; first += simd_block::size)
+                    {
+                        const simd_block block { first };
+                        const auto m = block_mask(block);
+                        if (m != 0)
+                            return first + simd_block::index(m);
+                    }
+                }
+#else
+                (void)block_mask;
+#endif
+                return std::find_if(first, last, pred);
+            }
+
+            /** \brief Writes `str` to `out` with \" replaced by " and any run of backslashes
+            collapsed into a single one, which is never longer than `str`.
+            @return number of characters written
+            */
+            template<typename CharT>
+            size_t unescape(std::basic_string_view<CharT> str, CharT* out) NOEXCEPT
+            {
+                const CharT* p = str.data();
+                const CharT* const last = p + str.size();
+                CharT* o = out;
+                while (p != last)
+                {
+                    if (*p != TYTI_L(CharT, '\\'))
+                    {
+                        *o++ = *p++;
+                        continue;
+                    }
+
+                    const CharT* run = p;
+                    while (p != last && *p == TYTI_L(CharT, '\\'))
+                        ++p;
+
+                    // the backslash before a quote is dropped, what remains of the run collapses
+                    if (p != last && *p == TYTI_L(CharT, '\"'))
+                    {
+                        if (p - run > 1)
+                            *o++ = TYTI_L(CharT, '\\');
+                        *o++ = *p++;
+                    } else
+                        *o++ = TYTI_L(CharT, '\\');
+                }
+                return static_cast<size_t>(o - out);
+            }
+
+            template<typename CharT>
+            std::basic_string<CharT> unescape(const token<CharT>& t)
+            {
+                std::basic_string<CharT> str(t.text);
+                if (t.escaped)
+                    str.resize(unescape(t.text, &str[0]));
                 return str;
             }
 
-            /** \brief Read VDF formatted sequences defined by the range [first, last).
-            If the file is mailformatted, parser will try to read it until it can.
-            @param first            begin iterator
-            @param end              end iterator
-            @param exclude_files    list of files which cant be included anymore.
-                                    prevents circular includes
+            /** \brief Splits VDF text into keys, values and object braces, working on pointers into the text.
+            Keys and values are either quoted, with \" escaping a quote, or words ending at whitespace.
+            Both line (//) and block comments are skipped.
 
-            can thow:
-                    - "std::runtime_error" if a parsing error occured
-                    - "std::bad_alloc" if not enough memory coup be allocated
+            In partial mode the text is a chunk that more text follows, anything that could continue
+            after its end makes next() return incomplete, with position() at its start. Comments
+            between objects and attributes are skipped across chunks instead of being kept.
             */
-            template <typename OutputT, typename IterT>
-            std::vector<std::unique_ptr<OutputT>> read_internal(IterT first, const IterT last, std::unordered_set< std::basic_string<typename IterT::value_type> >& exclude_files)
+            template<typename CharT>
+            class tokenizer
             {
-                static_assert(std::is_default_constructible<OutputT>::value,
-                    "Output Type must be default constructible (provide constructor without arguments)");
-                static_assert(std::is_move_constructible<OutputT>::value,
-                    "Output Type must be move constructible");
+                enum class comment_state
+                {
+                    none,
+                    line,
+                    block
+                };
+
+                const CharT* _cur;
+                const CharT* _last;
+                bool _partial = false;
+                comment_state _comment = comment_state::none;
+
+            public:
+                tokenizer(const CharT* first, const CharT* last) NOEXCEPT : _cur(first), _last(last) {}
+
+                /// continues with the text [first, last), keeping the state of an unfinished comment
+                void reset(const CharT* first, const CharT* last, bool partial) NOEXCEPT
+                {
+                    _cur = first;
+                    _last = last;
+                    _partial = partial;
+                }
 
-                typedef typename IterT::value_type charT;
+                /// where reading continues, the first character that has to be kept after incomplete
+                const CharT* position() const NOEXCEPT { return _cur; }
 
-                // function for skipping a comment block
-                // iter: iterator poition to the position after a '/'
-                auto skip_comments = [](IterT iter, const IterT& last) -> IterT {
-                    ++iter;
-                    if (iter != last)
+                /** \brief Reads the next key/value pair or object brace.
+                `key` is set for key_value and object_begin, `value` for key_value only.
+                throws "std::runtime_error" if the text is malformed
+                */
+                token_type next(token<CharT>& key, token<CharT>& value)
+                {
+                    for (;;)
                     {
-                        if (*iter == TYTI_L(charT, '/'))
+                        if (_comment != comment_state::none && !_finish_comment())
+                            return token_type::incomplete;
+
+                        _skip_whitespaces();
+                        if (_cur == _last)
+                            return _partial ? token_type::incomplete : token_type::end;
+                        if (*_cur == TYTI_L(CharT, '\0'))
+                            return token_type::end;
+
+                        if (*_cur == TYTI_L(CharT, '/'))
                         {
-                            // line comment, skip whole line
-                            iter = std::find(iter + 1, last, TYTI_L(charT, '\n'));
+                            if (!_skip_comment())
+                                return token_type::incomplete;
+                            continue;
                         }
 
-                        if (*iter == '*')
+                        if (*_cur == TYTI_L(CharT, '}'))
                         {
-                            // block comment, skip until next occurance of "*\"
-                            const std::basic_string<charT> search_str = TYTI_L(charT, "*/");
-                            iter = std::search(iter + 1, last, std::begin(search_str), std::end(search_str));
-                            iter += 2;
+                            ++_cur;
+                            return token_type::object_end;
                         }
+
+                        const auto start = _cur;
+                        if (!_string(key))
+                            return _incomplete(start);
+
+                        _skip_whitespaces();
+                        while (_cur != _last && *_cur == TYTI_L(CharT, '/'))
+                        {
+                            if (!_skip_comment())
+                                return _incomplete(start);
+                            _skip_whitespaces();
+                            if (_cur != _last && *_cur == TYTI_L(CharT, '}'))
+                                throw std::runtime_error { "key declared, but no value" };
+                        }
+                        if (_cur == _last)
+                        {
+                            if (_partial)
+                                return _incomplete(start);
+                            throw std::runtime_error { "key declared, but no value" };
+                        }
+
+                        if (*_cur == TYTI_L(CharT, '{'))
+                        {
+                            ++_cur;
+                            return token_type::object_begin;
+                        }
+
+                        if (!_string(value))
+                            return _incomplete(start);
+                        return token_type::key_value;
                     }
-                    return iter;
-                };
+                }
+
+            private:
+                // the key/value starting at `start` is read again once there is more text
+                token_type _incomplete(const CharT* start) NOEXCEPT
+                {
+                    _cur = start;
+                    _comment = comment_state::none;
+                    return token_type::incomplete;
+                }
+
+                void _skip_whitespaces() NOEXCEPT
+                {
+                    // mostly a line break and some indentation
+                    if (_cur == _last || !is_whitespace(*_cur))
+                        return;
+                    _cur = scan(_cur + 1, _last, [](CharT c) { return !is_whitespace(c); },
+                        [](const auto& b) { return b.all & ~b.whitespace(); });
+                }
+
+                // _cur is at a '/', returns false if the comment continues past the end of a partial text
+                bool _skip_comment() NOEXCEPT
+                {
+                    // whether this starts a comment depends on the next chunk
+                    if (_partial && _cur + 1 == _last)
+                        return false;
+
+                    ++_cur;
+                    if (_cur == _last)
+                        return true;
+
+                    if (*_cur == TYTI_L(CharT, '/'))
+                        _comment = comment_state::line;
+                    else if (*_cur == TYTI_L(CharT, '*'))
+                        _comment = comment_state::block;
+                    else
+                        return true;
+
+                    ++_cur;
+                    return _finish_comment();
+                }
 
-                auto end_quote = [](IterT iter, const IterT& last) -> IterT {
-                    const auto begin = iter;
-                    auto last_esc = iter;
-                    do
+                bool _finish_comment() NOEXCEPT
+                {
+                    if (_comment == comment_state::line)
                     {
-                        ++iter;
-                        iter = std::find(iter, last, TYTI_L(charT, '\"'));
-                        if (iter == last)
-                            break;
+                        // line comment, skip whole line
+                        _cur = scan(_cur, _last, [](CharT c) { return c == TYTI_L(CharT, '\n'); },
+                            [](const auto& b) { return b.eq('\n'); });
+                        if (_cur == _last && _partial)
+                            return false;
+                    } else
+                    {
+                        // block comment, skip until next occurance of "*/"
+                        auto found = _cur;
+                        for (;; ++found)
+                        {
+                            found = scan(found, _last, [](CharT c) { return c == TYTI_L(CharT, '*'); },
+                                [](const auto& b) { return b.eq('*'); });
+                            if (found == _last || found + 1 == _last)
+                            {
+                                found = _last;
+                                break;
+                            }
+                            if (found[1] == TYTI_L(CharT, '/'))
+                                break;
+                        }
+                        if (found == _last)
+                        {
+                            // a '*' at the end might be closed by the next chunk
+                            if (_partial)
+                            {
+                                _cur = (_cur != _last && *(_last - 1) == TYTI_L(CharT, '*')) ? _last - 1 : _last;
+                                return false;
+                            }
+                            _cur = _last;
+                        } else
+                            _cur = found + 2;
+                    }
+                    _comment = comment_state::none;
+                    return true;
+                }
 
-                        last_esc = std::prev(iter);
-                        while (last_esc != begin && *last_esc == '\\')
-                            --last_esc;
-                    } while (!(std::distance(last_esc, iter) % 2));
-                    if (iter == last)
-                        throw std::runtime_error { "quote was opened but not closed." };
+                static bool _is_quote_or_backslash(CharT c) NOEXCEPT
+                {
+                    return c == TYTI_L(CharT, '\"') || c == TYTI_L(CharT, '\\');
+                }
+
+                static bool _is_whitespace_or_backslash(CharT c) NOEXCEPT
+                {
+                    return is_whitespace(c) || c == TYTI_L(CharT, '\\');
+                }
+
+                /** \brief Skips the run of backslashes at `iter` and the character an odd run escapes,
+                which is a quote in quoted strings and whitespace in words.
+                `escaped` is set if unescape() changes the run, if it is longer than one or followed by a quote.
+                */
+                template<typename PredT>
+                const CharT* _skip_backslashes(const CharT* iter, PredT is_escapable, bool& escaped) const NOEXCEPT
+                {
+                    const auto run = iter;
+                    while (iter != _last && *iter == TYTI_L(CharT, '\\'))
+                        ++iter;
+                    if (iter - run > 1)
+                        escaped = true;
+                    if (iter == _last)
+                        return iter;
+
+                    if (*iter == TYTI_L(CharT, '\"'))
+                        escaped = true;
+                    if ((iter - run) % 2 != 0 && is_escapable(*iter))
+                        ++iter;
                     return iter;
-                };
+                }
 
-                auto end_word = [](IterT iter, const IterT& last)->IterT {
-                    const auto begin = iter;
-                    auto last_esc = iter;
-                    do
+                // returns false if the string continues past the end of a partial text
+                bool _string(token<CharT>& t)
+                {
+                    // text without backslashes needs no unescaping
+                    bool escaped = false;
+                    if (*_cur == TYTI_L(CharT, '\"'))
                     {
-                        ++iter;
-                        const std::basic_string<charT> symbols = TYTI_L(charT, " \n\v\f\r\t");
-                        iter = std::find_first_of(iter, last, symbols.begin(), symbols.end());
-                        if (iter == last)
+                        const auto begin = _cur + 1;
+                        auto iter = begin;
+                        for (;;)
+                        {
+                            iter = scan(iter, _last, _is_quote_or_backslash,
+                                [](const auto& b) { return b.eq('\"') | b.eq('\\'); });
+                            if (iter != _last && *iter == TYTI_L(CharT, '\\'))
+                            {
+                                iter = _skip_backslashes(iter, [](CharT c) { return c == TYTI_L(CharT, '\"'); }, escaped);
+                                continue;
+                            }
+                            if (iter == _last)
+                            {
+                                if (_partial)
+                                    return false;
+                                throw std::runtime_error { "quote was opened but not closed." };
+                            }
                             break;
+                        }
+                        t.text = { begin, static_cast<size_t>(iter - begin) };
+                        _cur = iter + 1;
+                    } else
+                    {
+                        // the first character of a word never escapes
+                        const auto begin = _cur;
+                        auto iter = begin + 1;
+                        if (*begin == TYTI_L(CharT, '\\') && iter != _last && (*iter == TYTI_L(CharT, '\"') || *iter == TYTI_L(CharT, '\\')))
+                            escaped = true;
+                        for (;;)
+                        {
+                            iter = scan(iter, _last, _is_whitespace_or_backslash,
+                                [](const auto& b) { return b.whitespace() | b.eq('\\'); });
+                            if (iter == _last || *iter != TYTI_L(CharT, '\\'))
+                                break;
+                            iter = _skip_backslashes(iter, is_whitespace<CharT>, escaped);
+                        }
+                        if (iter == _last && _partial)
+                            return false;
+                        t.text = { begin, static_cast<size_t>(iter - begin) };
+                        _cur = iter;
+                    }
+                    t.escaped = escaped;
+                    return true;
+                }
+            };
 
-                        last_esc = std::prev(iter);
-                        while (last_esc != begin && *last_esc == '\\')
-                            --last_esc;
-                    } while (!(std::distance(last_esc, iter) % 2));
-                    //if (iter == last)
-                    //	throw std::runtime_error{ "word wasnt properly ended" };
-                    return iter;
+            /// reports tokens to a handler, see tyti::vdf::parse
+            template<typename CharT>
+            class event_reader
+            {
+                tokenizer<CharT> _tokens { nullptr, nullptr };
+                token<CharT> _key, _value;
+
+                // escaped tokens are unescaped into these, they only ever grow to the longest one
+                std::basic_string<CharT> _key_buf, _value_buf;
+                size_t _depth = 0;
+
+            public:
+                enum class result
+                {
+                    end,            // end of the text
+                    incomplete,     // end of a partial text, continue at position()
+                    stopped         // by the handler
                 };
 
-                auto skip_whitespaces = [](IterT iter, const IterT& last)->IterT {
-                    iter = std::find_if_not(iter, last, [](charT c)
+                template<typename HandlerT>
+                result run(const CharT* first, const CharT* last, bool partial, HandlerT& handler)
+                {
+                    _tokens.reset(first, last, partial);
+                    for (;;)
+                    {
+                        switch (_tokens.next(_key, _value))
                         {
-                            // return true if whitespace
-                            const std::basic_string<charT> whitespaces = TYTI_L(charT, " \n\v\f\r\t");
-                            return std::any_of(whitespaces.begin(), whitespaces.end(), [c](charT pc) {return pc == c; });
-                        });
-                    return iter;
-                };
+                            case token_type::key_value:
+                                if (!handler.on_key_value(_view(_key, _key_buf), _view(_value, _value_buf)))
+                                    return result::stopped;
+                                break;
+
+                            case token_type::object_begin:
+                                ++_depth;
+                                if (!handler.on_object_begin(_view(_key, _key_buf)))
+                                    return result::stopped;
+                                break;
+
+                            case token_type::object_end:
+                                if (_depth == 0)
+                                    throw std::runtime_error { "object closed but not opened" };
+                                --_depth;
+                                if (!handler.on_object_end())
+                                    return result::stopped;
+                                break;
+
+                            case token_type::incomplete:
+                                return result::incomplete;
+
+                            case token_type::end:
+                                return result::end;
+                        }
+                    }
+                }
+
+                const CharT* position() const NOEXCEPT { return _tokens.position(); }
+
+            private:
+                static std::basic_string_view<CharT> _view(const token<CharT>& t, std::basic_string<CharT>& buf)
+                {
+                    if (!t.escaped)
+                        return t.text;
+                    if (buf.size() < t.text.size())
+                        buf.resize(t.text.size());
+                    return { buf.data(), unescape(t.text, &buf[0]) };
+                }
+            };
+
+            /// VDF text to parse, as pointers into the caller's text or a copy of it
+            template<typename IterT>
+            class contiguous_text
+            {
+                typedef typename std::iterator_traits<IterT>::value_type charT;
+                std::basic_string<charT> _copy;
+                const charT* _first;
+                const charT* _last;
 
-                auto strip_escape_symbols = [](std::basic_string<charT> s) {
-                    auto quote_searcher = [&s](size_t pos) { return s.find(TYTI_L(charT, "\\\""), pos); };
-                    auto p = quote_searcher(0);
-                    while (p != s.npos)
+            public:
+                contiguous_text(IterT first, IterT last)
+                {
+                    if constexpr (std::contiguous_iterator<IterT>)
+                    {
+                        _first = std::to_address(first);
+                        _last = _first + std::distance(first, last);
+                    } else
                     {
-                        s.replace(p, 2, TYTI_L(charT, "\""));
-                        p = quote_searcher(p);
+                        _copy.assign(first, last);
+                        _first = _copy.data();
+                        _last = _first + _copy.size();
                     }
-                    auto searcher = [&s](size_t pos) { return s.find(TYTI_L(charT, "\\\\"), pos); };
-                    p = searcher(0);
-                    while (p != s.npos)
+                }
+
+                const charT* first() const NOEXCEPT { return _first; }
+                const charT* last() const NOEXCEPT { return _last; }
+            };
+
+            template<typename CharT>
+            bool is_include(std::basic_string_view<CharT> key) NOEXCEPT
+            {
+                return key == TYTI_L(CharT, "#include") || key == TYTI_L(CharT, "#base");
+            }
+        } // namespace detail
+
+        /** \brief Parses VDF text in a single pass, reporting what it reads to `handler`, which needs:
+
+            bool on_object_begin(std::basic_string_view<CharT> name);
+            bool on_key_value(std::basic_string_view<CharT> key, std::basic_string_view<CharT> value);
+            bool on_object_end();
+
+        Returning false from any of them stops parsing. Escape sequences are already replaced in
+        the views, which are only valid during the call. #include and #base are reported as
+        key/values, objects left open at the end are not closed.
+        @param first    begin iterator
+        @param last     end iterator
+        @param handler  receives the events
+        @return         false if the handler stopped, true if the end of the text was reached
+
+        can thow:
+                - "std::runtime_error" if a parsing error occured
+        */
+        template<typename IterT, typename HandlerT>
+        bool parse(IterT first, const IterT last, HandlerT& handler)
+        {
+            typedef typename std::iterator_traits<IterT>::value_type charT;
+            const detail::contiguous_text<IterT> text { first, last };
+
+            detail::event_reader<charT> reader;
+            return reader.run(text.first(), text.last(), false, handler) == detail::event_reader<charT>::result::end;
+        }
+
+        /** \brief Parses VDF text that arrives in chunks, reporting what it reads to a handler like parse().
+        Chunks may end anywhere, even within a key, value or escape sequence. Only the unfinished
+        key/value at the end of a chunk is kept until the next one, comments between attributes and
+        objects are skipped without being kept. The events are the same as those of parse() on the
+        whole text.
+        */
+        template<typename CharT, typename HandlerT>
+        class basic_push_parser
+        {
+            typedef typename detail::event_reader<CharT>::result result;
+
+            HandlerT& _handler;
+            detail::event_reader<CharT> _reader;
+            std::basic_string<CharT> _pending;
+            bool _done = false;
+            bool _stopped = false;
+
+        public:
+            explicit basic_push_parser(HandlerT& handler) : _handler(handler) {}
+
+            /** \brief Parses the next chunk of text.
+            @return false if the handler stopped, further chunks are ignored after that
+            throws "std::runtime_error" if a parsing error occured
+            */
+            bool feed(const CharT* data, size_t size)
+            {
+                if (_done)
+                    return !_stopped;
+
+                const CharT* first = data;
+                const CharT* last = data + size;
+                if (!_pending.empty())
+                {
+                    _pending.append(data, size);
+                    first = _pending.data();
+                    last = first + _pending.size();
+                }
+
+                const result r = _reader.run(first, last, true, _handler);
+                if (r != result::incomplete)
+                    return _end(r);
+
+                // keep what has to be read again
+                const CharT* rest = _reader.position();
+                if (_pending.empty())
+                    _pending.assign(rest, last);
+                else
+                    _pending.erase(0, static_cast<size_t>(rest - first));
+                return true;
+            }
+
+            bool feed(std::basic_string_view<CharT> chunk)
+            {
+                return feed(chunk.data(), chunk.size());
+            }
+
+            /** \brief Parses what remains after the last chunk.
+            @return false if the handler stopped
+            throws "std::runtime_error" if the text ends within a quote or a key without a value
+            */
+            bool finish()
+            {
+                if (_done)
+                    return !_stopped;
+                return _end(_reader.run(_pending.data(), _pending.data() + _pending.size(), false, _handler));
+            }
+
+        private:
+            bool _end(result r)
+            {
+                _done = true;
+                _stopped = r == result::stopped;
+                _pending = {};
+                return !_stopped;
+            }
+        };
+
+        template<typename HandlerT>
+        using push_parser = basic_push_parser<char, HandlerT>;
+
+        template<typename HandlerT>
+        using wpush_parser = basic_push_parser<wchar_t, HandlerT>;
+
+        /** \brief Parses a stream chunk by chunk, the stream doesn't need to be seekable.
+        @return false if the handler stopped
+        throws "std::runtime_error" if a parsing error occured
+        */
+        template<typename iStreamT, typename HandlerT>
+        bool parse(iStreamT& inStream, HandlerT& handler)
+        {
+            typedef typename iStreamT::char_type charT;
+            basic_push_parser<charT, HandlerT> parser { handler };
+
+            std::unique_ptr<charT[]> buf { new charT[detail::stream_chunk_size] };
+            do
+            {
+                inStream.read(buf.get(), detail::stream_chunk_size);
+                if (!parser.feed(buf.get(), static_cast<size_t>(inStream.gcount())))
+                    return false;
+            } while (inStream);
+            return parser.finish();
+        }
+
+        namespace detail
+        {
+            /// builds trees of objects with add_attribute, add_child and set_name
+            template<typename OutputT, typename CharT>
+            class tree_builder
+            {
+                typedef std::basic_string<CharT> string_type;
+                typedef std::basic_string_view<CharT> view_type;
+
+                std::unique_ptr<OutputT> _cur;
+                std::vector<std::unique_ptr<OutputT>> _roots;
+                std::stack<std::unique_ptr<OutputT>> _lvls;
+                std::unordered_set<string_type>& _exclude_files;
+
+            public:
+                explicit tree_builder(std::unordered_set<string_type>& exclude_files) : _exclude_files(exclude_files) {}
+
+                /// objects closed at the top level, objects that are never closed are dropped
+                std::vector<std::unique_ptr<OutputT>>& roots() NOEXCEPT { return _roots; }
+
+                bool on_object_begin(view_type name)
+                {
+                    if (_cur)
+                        _lvls.push(std::move(_cur));
+                    _cur = std::make_unique<OutputT>();
+                    if constexpr (requires { _cur->set_name(name); })
+                        _cur->set_name(name);
+                    else
+                        _cur->set_name(string_type(name));
+                    return true;
+                }
+
+                bool on_key_value(view_type key, view_type value)
+                {
+                    if (!is_include(key))
                     {
-                        s.replace(p, 2, TYTI_L(charT, "\\"));
-                        p = searcher(p);
+                        if (!_cur)
+                            throw std::runtime_error { "attribute outside of an object" };
+                        // objects taking views copy them straight into their own storage
+                        if constexpr (requires { _cur->add_attribute(key, value); })
+                            _cur->add_attribute(key, value);
+                        else
+                            _cur->add_attribute(string_type(key), string_type(value));
+                        return true;
                     }
-                    return s;
-                };
 
+                    string_type file(value);
+                    if (_exclude_files.insert(file).second)
+                    {
+                        std::basic_ifstream<CharT> i(detail::string_converter(file));
+                        auto str = read_file(i);
 
-                //read header
-                // first, quoted name
-                std::unique_ptr<OutputT> curObj = nullptr;
-                std::vector<std::unique_ptr<OutputT>> roots;
-                std::stack<std::unique_ptr<OutputT>> lvls;
-                auto curIter = first;
+                        tree_builder included { _exclude_files };
+                        parse(str.begin(), str.end(), included);
+                        for (auto& n : included.roots())
+                        {
+                            if (_cur)
+                                _cur->add_child(std::move(n));
+                            else
+                                _roots.push_back(std::move(n));
+                        }
+                        _exclude_files.erase(file);
+                    }
+                    return true;
+                }
 
-                while (curIter != last && *curIter != '\0')
+                bool on_object_end()
                 {
-                    //find first starting attrib/child, or ending
-                    curIter = skip_whitespaces(curIter, last);
-                    if (curIter == last || *curIter == '\0') break;
-                    if (*curIter == TYTI_L(charT, '/'))
+                    if (!_lvls.empty())
                     {
-                        curIter = skip_comments(curIter, last);
-                    } else if (*curIter != TYTI_L(charT, '}'))
+                        //get object before
+                        std::unique_ptr<OutputT> prev { std::move(_lvls.top()) };
+                        _lvls.pop();
+
+                        // add finished obj to obj before and release it from processing
+                        prev->add_child(std::move(_cur));
+                        _cur = std::move(prev);
+                    } else
                     {
+                        _roots.push_back(std::move(_cur));
+                    }
+                    return true;
+                }
+            };
 
-                        // get key
-                        const auto keyEnd = (*curIter == TYTI_L(charT, '\"')) ? end_quote(curIter, last) : end_word(curIter, last);
-                        if (*curIter == TYTI_L(charT, '\"'))
-                            ++curIter;
-                        std::basic_string<charT> key(curIter, keyEnd);
-                        key = strip_escape_symbols(key);
-                        curIter = keyEnd + ((*keyEnd == TYTI_L(charT, '\"')) ? 1 : 0);
+            /// builds a basic_flat_object, appending nodes in the order of the text
+            template<typename CharT>
+            class flat_builder
+            {
+                typedef basic_flat_object<CharT> tree_type;
+                typedef typename tree_type::index_type index_type;
+                typedef typename tree_type::node node_type;
+                typedef std::basic_string<CharT> string_type;
+                typedef std::basic_string_view<CharT> view_type;
+                static CONSTEXPR index_type npos = tree_type::npos;
+
+                struct level
+                {
+                    index_type object;
+                    index_type last_child;
+                    // sibling before `object`, to drop it again if it is never closed
+                    index_type prev;
+                };
 
-                        curIter = skip_whitespaces(curIter, last);
-                        while (*curIter == TYTI_L(charT, '/'))
-                        {
+                tree_type& _tree;
+                std::vector<level> _lvls;
+                std::unordered_set<string_type>& _exclude_files;
 
-                            curIter = skip_comments(curIter, last);
-                            if (curIter == last || *curIter == '}')
-                                throw std::runtime_error { "key declared, but no value" };
-                            curIter = skip_whitespaces(curIter, last);
-                            if (curIter == last || *curIter == '}')
-                                throw std::runtime_error { "key declared, but no value" };
-                        }
-                        // get value
-                        if (*curIter != '{')
-                        {
-                            const auto valueEnd = (*curIter == TYTI_L(charT, '\"')) ? end_quote(curIter, last) : end_word(curIter, last);
-                            if (*curIter == TYTI_L(charT, '\"'))
-                                ++curIter;
+            public:
+                flat_builder(tree_type& tree, std::unordered_set<string_type>& exclude_files)
+                    : _tree(tree), _exclude_files(exclude_files)
+                {
+                    // unnamed node holding the top level objects
+                    _tree._nodes.emplace_back();
+                    _lvls.push_back({ 0, npos, npos });
+                }
 
-                            auto value = std::basic_string<charT>(curIter, valueEnd);
-                            value = strip_escape_symbols(value);
-                            curIter = valueEnd + ((*valueEnd == TYTI_L(charT, '\"')) ? 1 : 0);
+                /// reserves the string pool for the size of the text, which it never exceeds
+                void reserve(size_t text_size)
+                {
+                    _tree._pool.reserve(_tree._pool.size() + text_size);
+                }
 
-                            // process value
-                            if (key != TYTI_L(charT, "#include") && key != TYTI_L(charT, "#base"))
-                            {
-                                curObj->add_attribute(std::move(key), std::move(value));
-                            } else
-                            {
-                                if (exclude_files.find(value) == exclude_files.end())
-                                {
-                                    exclude_files.insert(value);
-                                    std::basic_ifstream<charT> i(detail::string_converter(value));
-                                    auto str = read_file(i);
-                                    auto file_objs = read_internal<OutputT>(str.begin(), str.end(), exclude_files);
-                                    for (auto& n : file_objs)
-                                    {
-                                        if (curObj)
-                                            curObj->add_child(std::move(n));
-                                        else
-                                            roots.push_back(std::move(n));
-                                    }
-                                    exclude_files.erase(value);
-                                }
-                            }
-                        } else if (*curIter == '{')
-                        {
-                            if (curObj)
-                                lvls.push(std::move(curObj));
-                            curObj = std::make_unique<OutputT>();
-                            curObj->set_name(std::move(key));
-                            ++curIter;
-                        }
+                bool on_object_begin(view_type name)
+                {
+                    node_type n;
+                    _string(name, n.key_offset, n.key_size);
+                    const index_type prev = _lvls.back().last_child;
+                    _lvls.push_back({ _append(n), npos, prev });
+                    return true;
+                }
+
+                bool on_key_value(view_type key, view_type value)
+                {
+                    if (!is_include(key))
+                    {
+                        if (_lvls.size() == 1)
+                            throw std::runtime_error { "attribute outside of an object" };
+                        node_type n;
+                        _string(key, n.key_offset, n.key_size);
+                        _string(value, n.value_offset, n.value_size);
+                        _append(n);
+                        return true;
                     }
-                    //end of new object
-                    else if (*curIter == TYTI_L(charT, '}'))
+
+                    string_type file(value);
+                    if (_exclude_files.insert(file).second)
                     {
-                        if (!lvls.empty())
-                        {
-                            //get object before
-                            std::unique_ptr<OutputT> prev { std::move(lvls.top()) };
-                            lvls.pop();
+                        std::basic_ifstream<CharT> i(detail::string_converter(file));
+                        auto str = read_file(i);
+
+                        const size_t depth = _lvls.size();
+                        reserve(str.size());
+                        parse(str.begin(), str.end(), *this);
+                        _drop_open(depth);
+                        _exclude_files.erase(file);
+                    }
+                    return true;
+                }
 
-                            // add finished obj to obj before and release it from processing
-                            prev->add_child(std::move(curObj));
-                            curObj = std::move(prev);
-                        } else
-                        {
-                            roots.push_back(std::move(curObj));
-                            curObj.reset();
-                        }
-                        ++curIter;
+                bool on_object_end()
+                {
+                    _lvls.pop_back();
+                    return true;
+                }
+
+                void finish()
+                {
+                    _drop_open(1);
+
+                    // a single top level object is the root itself
+                    const node_type& top = _tree._nodes[0];
+                    if (top.first_child != npos && _tree._nodes[top.first_child].next_sibling == npos)
+                    {
+                        _tree._root = top.first_child;
+                        _tree._nodes[_tree._root].parent = npos;
                     }
+
+                    // the pool was reserved for the whole text, quotes, whitespace and comments included
+                    _tree._pool.shrink_to_fit();
+                    _tree._nodes.shrink_to_fit();
+                }
+
+            private:
+                static index_type _index(size_t i)
+                {
+                    if (i >= npos)
+                        throw std::length_error { "vdf: too large for a flat object" };
+                    return static_cast<index_type>(i);
+                }
+
+                // like tree_builder, objects that are never closed are dropped
+                void _drop_open(size_t depth)
+                {
+                    if (_lvls.size() <= depth)
+                        return;
+
+                    const level& open = _lvls[depth];
+                    level& parent = _lvls[depth - 1];
+                    if (open.prev == npos)
+                        _tree._nodes[parent.object].first_child = npos;
+                    else
+                        _tree._nodes[open.prev].next_sibling = npos;
+                    parent.last_child = open.prev;
+                    _lvls.resize(depth);
+                }
+
+                void _string(view_type str, index_type& offset, index_type& size)
+                {
+                    offset = _index(_tree._pool.size());
+                    size = _index(str.size());
+                    _tree._pool.append(str);
+                }
+
+                index_type _append(node_type n)
+                {
+                    level& lvl = _lvls.back();
+                    const index_type i = _index(_tree._nodes.size());
+                    n.parent = lvl.object;
+                    if (lvl.last_child == npos)
+                        _tree._nodes[lvl.object].first_child = i;
+                    else
+                        _tree._nodes[lvl.last_child].next_sibling = i;
+                    lvl.last_child = i;
+                    _tree._nodes.push_back(n);
+                    return i;
+                }
+            };
+
+            /** \brief Builds an OutputT from what `parse_with(handler)` reports to the handler.
+            Several top level objects become children of an unnamed one.
+            @param size_hint    size of the text if known, 0 otherwise
+            */
+            template<typename OutputT, typename CharT, typename ParseF>
+            OutputT build(ParseF&& parse_with, size_t size_hint)
+            {
+                static_assert(std::is_default_constructible<OutputT>::value,
+                    "Output Type must be default constructible (provide constructor without arguments)");
+                static_assert(std::is_move_constructible<OutputT>::value,
+                    "Output Type must be move constructible");
+
+                auto exclude_files = std::unordered_set< std::basic_string<CharT> > {};
+
+                // built straight from the events, without intermediate objects
+                if constexpr (std::is_same<OutputT, basic_flat_object<CharT> >::value)
+                {
+                    OutputT result;
+                    flat_builder<CharT> builder { result, exclude_files };
+                    builder.reserve(size_hint);
+                    parse_with(builder);
+                    builder.finish();
+                    return result;
+                } else
+                {
+                    tree_builder<OutputT, CharT> builder { exclude_files };
+                    parse_with(builder);
+
+                    auto& roots = builder.roots();
+                    OutputT result;
+                    if (roots.size() > 1)
+                    {
+                        for (auto& i : roots)
+                            result.add_child(std::move(i));
+                    } else if (roots.size() == 1)
+                        result = std::move(*roots[0]);
+
+                    return result;
                 }
-                return roots;
             }
 
+            /// calls `read_with()`, turning the exceptions it throws into error codes
+            template<typename OutputT, typename ReadF>
+            OutputT read_or_error(std::error_code& ec, ReadF&& read_with) NOEXCEPT
+            {
+                ec.clear();
+                OutputT r {};
+                try
+                {
+                    r = read_with();
+                } catch (std::runtime_error&)
+                {
+                    ec = std::make_error_code(std::errc::protocol_error);
+                } catch (std::bad_alloc&)
+                {
+                    ec = std::make_error_code(std::errc::not_enough_memory);
+                } catch (...)
+                {
+                    ec = std::make_error_code(std::errc::invalid_argument);
+                }
+                return r;
+            }
         } // namespace detail
 
         /** \brief Read VDF formatted sequences defined by the range [first, last).
@@ -476,18 +1392,9 @@ namespace tyti
         template<typename OutputT, typename IterT>
         OutputT read(IterT first, const IterT last)
         {
-            auto exclude_files = std::unordered_set< std::basic_string<typename IterT::value_type> > {};
-            auto roots = detail::read_internal<OutputT>(first, last, exclude_files);
-
-            OutputT result;
-            if (roots.size() > 1)
-            {
-                for (auto& i : roots)
-                    result.add_child(std::move(i));
-            } else if (roots.size() == 1)
-                result = std::move(*roots[0]);
-
-            return result;
+            typedef typename std::iterator_traits<IterT>::value_type charT;
+            return detail::build<OutputT, charT>([&](auto& handler) { parse(first, last, handler); },
+                static_cast<size_t>(std::distance(first, last)));
         }
 
         /** \brief Read VDF formatted sequences defined by the range [first, last).
@@ -503,24 +1410,8 @@ namespace tyti
         */
         template<typename OutputT, typename IterT >
         OutputT read(IterT first, IterT last, std::error_code& ec) NOEXCEPT
-
         {
-            ec.clear();
-            OutputT r {};
-            try
-            {
-                r = read<OutputT>(first, last);
-            } catch (std::runtime_error&)
-            {
-                ec = std::make_error_code(std::errc::protocol_error);
-            } catch (std::bad_alloc&)
-            {
-                ec = std::make_error_code(std::errc::not_enough_memory);
-            } catch (...)
-            {
-                ec = std::make_error_code(std::errc::invalid_argument);
-            }
-            return r;
+            return detail::read_or_error<OutputT>(ec, [&] { return read<OutputT>(first, last); });
         }
 
         /** \brief Read VDF formatted sequences defined by the range [first, last).
@@ -556,18 +1447,13 @@ namespace tyti
             return read< basic_object<typename IterT::value_type> >(first, last);
         }
 
-        /** \brief Loads a stream (e.g. filestream) into the memory and parses the vdf formatted data.
-            throws "std::bad_alloc" if file buffer could not be allocated
+        /** \brief Parses the vdf formatted data of a stream (e.g. filestream) as it is read.
+            ec is set like for read(first, last, ec)
         */
         template<typename OutputT, typename iStreamT>
         OutputT read(iStreamT& inStream, std::error_code& ec)
         {
-            // cache the file
-            typedef typename iStreamT::char_type charT;
-            std::basic_string<charT> str = detail::read_file(inStream);
-
-            // parse it
-            return read<OutputT>(str.begin(), str.end(), ec);
+            return detail::read_or_error<OutputT>(ec, [&] { return read<OutputT>(inStream); });
         }
 
         template<typename iStreamT>
@@ -576,8 +1462,7 @@ namespace tyti
             return read<basic_object<typename iStreamT::char_type> >(inStream, ec);
         }
 
-        /** \brief Loads a stream (e.g. filestream) into the memory and parses the vdf formatted data.
-            throws "std::bad_alloc" if file buffer could not be allocated
+        /** \brief Parses the vdf formatted data of a stream (e.g. filestream) as it is read.
             ok == false, if a parsing error occured
         */
         template<typename OutputT, typename iStreamT>
@@ -595,19 +1480,16 @@ namespace tyti
             return read< basic_object<typename iStreamT::char_type> >(inStream, ok);
         }
 
-        /** \brief Loads a stream (e.g. filestream) into the memory and parses the vdf formatted data.
-            throws "std::bad_alloc" if file buffer could not be allocated
+        /** \brief Parses the vdf formatted data of a stream (e.g. filestream) as it is read,
+            without loading all of it into memory. The stream doesn't need to be seekable.
+            throws "std::bad_alloc" if not enough memory could be allocated
             throws "std::runtime_error" if a parsing error occured
         */
         template<typename OutputT, typename iStreamT>
         OutputT read(iStreamT& inStream)
         {
-
-            // cache the file
             typedef typename iStreamT::char_type charT;
-            std::basic_string<charT> str = detail::read_file(inStream);
-            // parse it
-            return read<OutputT>(str.begin(), str.end());
+            return detail::build<OutputT, charT>([&](auto& handler) { parse(inStream, handler); }, 0);
         }
 
         template<typename iStreamT>
@@ -0,0 +1,139 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "nao/arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace {
+    constexpr size_t max_chunk_size = 1 << 20;
+
+    thread_local std::pmr::memory_resource* scoped_resource = nullptr;
+
+    std::byte* align_up(std::byte* p, size_t alignment) {
+        auto v = reinterpret_cast<uintptr_t>(p);
+        return p + (((v + alignment - 1) & ~(alignment - 1)) - v);
+    }
+}
+
+namespace nao {
+    arena::arena(size_t initial_size, std::pmr::memory_resource* upstream)
+        : _upstream { upstream }
+        , _first_size { std::max<size_t>(initial_size, 64) }
+        , _next_size { _first_size } { }
+
+    arena::~arena() {
+        release();
+    }
+
+    arena::chunk* arena::_new_chunk(size_t size) {
+        // Sizes from initial_size or large requests are arbitrary, keep them a multiple of the alignment
+        size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+        void* mem = _upstream->allocate(size, alignof(std::max_align_t));
+        _reserved += size;
+        return new (mem) chunk { nullptr, size };
+    }
+
+    void arena::_free_chunks(chunk* until) {
+        while (_head != until) {
+            chunk* prev = _head->prev;
+            _reserved -= _head->size;
+            _upstream->deallocate(_head, _head->size, alignof(std::max_align_t));
+            _head = prev;
+        }
+    }
+
+    void arena::release() {
+        _free_chunks(nullptr);
+        _pos = _end = nullptr;
+        _used = 0;
+        _next_size = _first_size;
+    }
+
+    void arena::reset() {
+        if (!_head) {
+            return;
+        }
+
+        // The head is always the chunk being allocated from, and the largest regular one
+        chunk* keep = _head;
+        _head = keep->prev;
+        _free_chunks(nullptr);
+
+        keep->prev = nullptr;
+        _head = keep;
+        _reserved = keep->size;
+        _pos = reinterpret_cast<std::byte*>(keep + 1);
+        _used = 0;
+    }
+
+    void* arena::do_allocate(size_t bytes, size_t alignment) {
+        // Padding for the alignment alone may already run past the end of the chunk
+        std::byte* p = align_up(_pos, alignment);
+        if (!_pos || p > _end || bytes > static_cast<size_t>(_end - p)) {
+            size_t needed = sizeof(chunk) + bytes + alignment;
+
+            // Large requests get a chunk of their own behind the current one, which stays the head
+            if (_head && needed > _next_size / 4) {
+                chunk* own = _new_chunk(needed);
+                own->prev = _head->prev;
+                _head->prev = own;
+                _used += bytes;
+                return align_up(reinterpret_cast<std::byte*>(own + 1), alignment);
+            }
+
+            size_t size = std::max(_next_size, needed);
+            chunk* c = _new_chunk(size);
+            c->prev = _head;
+            _head = c;
+            _next_size = std::min(_next_size * 2, max_chunk_size);
+
+            _pos = reinterpret_cast<std::byte*>(c + 1);
+            _end = reinterpret_cast<std::byte*>(c) + c->size;
+            p = align_up(_pos, alignment);
+        }
+
+        _pos = p + bytes;
+        _used += bytes;
+        return p;
+    }
+
+    void arena::do_deallocate(void* p, size_t bytes, size_t) {
+        // Growing containers often free their previous allocation right away
+        if (static_cast<std::byte*>(p) + bytes == _pos) {
+            _pos = static_cast<std::byte*>(p);
+            _used -= bytes;
+        }
+    }
+
+    bool arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* current_resource() noexcept {
+        return scoped_resource ? scoped_resource : std::pmr::get_default_resource();
+    }
+
+    resource_scope::resource_scope(std::pmr::memory_resource& resource) noexcept
+        : _prev { scoped_resource } {
+        scoped_resource = &resource;
+    }
+
+    resource_scope::~resource_scope() {
+        scoped_resource = _prev;
+    }
+}
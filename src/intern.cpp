@@ -0,0 +1,148 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "nao/intern.h"
+#include "nao/arena.h"
+
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <unordered_set>
+
+namespace {
+    using nao::detail::intern_entry;
+
+    /**
+     * @brief A string to look up, with its hash computed once.
+     */
+    struct intern_key {
+        std::string_view str;
+        size_t hash;
+    };
+
+    struct entry_hash {
+        using is_transparent = void;
+
+        size_t operator()(const intern_entry* entry) const { return entry->hash; }
+        size_t operator()(const intern_key& key) const { return key.hash; }
+    };
+
+    struct entry_equal {
+        using is_transparent = void;
+
+        bool operator()(const intern_entry* lhs, const intern_entry* rhs) const {
+            return lhs == rhs;
+        }
+
+        bool operator()(const intern_key& lhs, const intern_entry* rhs) const {
+            return lhs.hash == rhs->hash && lhs.str == std::string_view { rhs->data(), rhs->size };
+        }
+
+        bool operator()(const intern_entry* lhs, const intern_key& rhs) const {
+            return (*this)(rhs, lhs);
+        }
+    };
+
+    intern_entry* construct_entry(nao::arena& arena, std::string_view str, size_t hash) {
+        void* mem = arena.allocate(sizeof(intern_entry) + str.size() + 1, alignof(intern_entry));
+        auto entry = new (mem) intern_entry { hash, str.size() };
+        auto chars = reinterpret_cast<char*>(entry + 1);
+        std::memcpy(chars, str.data(), str.size());
+        chars[str.size()] = '\0';
+        return entry;
+    }
+
+    size_t shard_of(size_t hash, size_t count) {
+        // The low bits pick the bucket within the shard's set
+        return (hash >> 24) % count;
+    }
+}
+
+namespace nao {
+    struct intern_pool::shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_set<const intern_entry*, entry_hash, entry_equal> entries;
+        arena entries_arena { 1024 };
+    };
+
+    intern_pool::intern_pool() {
+        for (auto& shard : _shards) {
+            shard = std::make_unique<intern_pool::shard>();
+        }
+    }
+
+    intern_pool::~intern_pool() = default;
+
+    interned intern_pool::intern(std::string_view str) {
+        intern_key key { str, std::hash<std::string_view> {}(str) };
+        shard& s = *_shards[shard_of(key.hash, shard_count)];
+
+        {
+            std::shared_lock lock { s.mutex };
+            auto it = s.entries.find(key);
+            if (it != s.entries.end()) {
+                return interned { *it };
+            }
+        }
+
+        std::unique_lock lock { s.mutex };
+
+        // Another thread may have added it in between
+        auto it = s.entries.find(key);
+        if (it != s.entries.end()) {
+            return interned { *it };
+        }
+
+        const intern_entry* entry = construct_entry(s.entries_arena, str, key.hash);
+        s.entries.insert(entry);
+        return interned { entry };
+    }
+
+    interned intern_pool::find(std::string_view str) const {
+        intern_key key { str, std::hash<std::string_view> {}(str) };
+        const shard& s = *_shards[shard_of(key.hash, shard_count)];
+
+        std::shared_lock lock { s.mutex };
+        auto it = s.entries.find(key);
+        return it != s.entries.end() ? interned { *it } : interned {};
+    }
+
+    size_t intern_pool::size() const {
+        size_t res = 0;
+        for (const auto& s : _shards) {
+            std::shared_lock lock { s->mutex };
+            res += s->entries.size();
+        }
+
+        return res;
+    }
+
+    size_t intern_pool::memory_used() const {
+        size_t res = 0;
+        for (const auto& s : _shards) {
+            std::shared_lock lock { s->mutex };
+            res += s->entries_arena.reserved();
+        }
+
+        return res;
+    }
+
+    intern_pool& default_intern_pool() {
+        // Never destroyed, handles may be used during static destruction
+        static intern_pool* pool = new intern_pool();
+        return *pool;
+    }
+}
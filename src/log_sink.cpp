@@ -0,0 +1,238 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "nao/log_sink.h"
+
+#ifdef _WIN32
+#include "nao/strings.h"
+
+#include <windows.h>
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace nao {
+    buffered_sink::buffered_sink(size_t capacity) : _capacity { capacity } {
+        _buffer.reserve(capacity);
+    }
+
+    void buffered_sink::write(std::span<const std::string_view> messages) {
+        for (std::string_view msg : messages) {
+            if (_buffer.size() + msg.size() > _capacity) {
+                flush();
+
+                // Don't bother copying what would not fit anyway
+                if (msg.size() >= _capacity) {
+                    commit(msg);
+                    continue;
+                }
+            }
+
+            _buffer.append(msg);
+        }
+    }
+
+    void buffered_sink::flush() {
+        if (!_buffer.empty()) {
+            // Discard the data if commit throws too, or every following flush would fail on it again
+            try {
+                commit(_buffer);
+            } catch (...) {
+                _buffer.clear();
+                throw;
+            }
+
+            _buffer.clear();
+        }
+    }
+
+    stream_sink::stream_sink(std::FILE* stream, size_t capacity)
+        : buffered_sink { capacity }, _stream { stream } { }
+
+    void stream_sink::commit(std::string_view data) {
+        std::fwrite(data.data(), 1, data.size(), _stream);
+        std::fflush(_stream);
+    }
+
+    file_sink::file_sink(const std::filesystem::path& path, size_t capacity)
+        : buffered_sink { capacity } {
+        // We do our own buffering
+        _file.rdbuf()->pubsetbuf(nullptr, 0);
+        _file.open(path, std::ios::binary | std::ios::app);
+
+        if (!_file) {
+            throw std::runtime_error("failed opening log file " + path.string());
+        }
+    }
+
+    void file_sink::commit(std::string_view data) {
+        _file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        _file.flush();
+    }
+
+    rotating_file_sink::rotating_file_sink(std::filesystem::path path, uint64_t max_size,
+        std::chrono::seconds max_age, size_t max_files, size_t capacity)
+        : buffered_sink { capacity }, _path { std::move(path) }
+        , _max_size { max_size }, _max_age { max_age }, _max_files { max_files } {
+        _open();
+    }
+
+    void rotating_file_sink::commit(std::string_view data) {
+        bool too_old = _max_age > std::chrono::seconds::zero()
+            && std::chrono::steady_clock::now() - _opened >= _max_age;
+
+        if (too_old) {
+            _rotate();
+        }
+
+        // A buffer holds many lines, split it between them so that no file grows past the limit
+        while (_max_size > 0 && _size + data.size() > _max_size) {
+            uint64_t room = _max_size - std::min(_size, _max_size);
+            size_t end = room > 0 ? data.rfind('\n', static_cast<size_t>(room - 1)) : std::string_view::npos;
+
+            if (end == std::string_view::npos) {
+                if (_size > 0) {
+                    _rotate();
+
+                    // Keep writing to the old file rather than lose output
+                    if (_size > 0) {
+                        break;
+                    }
+
+                    continue;
+                }
+
+                // A line longer than the limit gets a file of its own
+                end = data.find('\n');
+                if (end == std::string_view::npos) {
+                    break;
+                }
+            }
+
+            _write(data.substr(0, end + 1));
+            data.remove_prefix(end + 1);
+        }
+
+        if (!data.empty()) {
+            _write(data);
+        }
+    }
+
+    bool rotating_file_sink::accepts_binary() const {
+        // A newline byte inside a binary record would split it across files
+        return false;
+    }
+
+    void rotating_file_sink::_write(std::string_view data) {
+        _file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        _file.flush();
+        _size += data.size();
+    }
+
+    void rotating_file_sink::_open() {
+        _file.rdbuf()->pubsetbuf(nullptr, 0);
+        _file.open(_path, std::ios::binary | std::ios::app);
+
+        if (!_file) {
+            throw std::runtime_error("failed opening log file " + _path.string());
+        }
+
+        std::error_code ec;
+        _size = std::filesystem::file_size(_path, ec);
+        if (ec) {
+            _size = 0;
+        }
+
+        _opened = std::chrono::steady_clock::now();
+    }
+
+    void rotating_file_sink::_rotate() {
+        _file.close();
+
+        auto numbered = [this](size_t i) {
+            std::filesystem::path path = _path;
+            path += '.';
+            path += std::to_string(i);
+            return path;
+        };
+
+        // Failing to rotate should never lose log output, so errors are ignored
+        std::error_code ec;
+        if (_max_files == 0) {
+            std::filesystem::remove(_path, ec);
+        } else {
+            std::filesystem::remove(numbered(_max_files), ec);
+            for (size_t i = _max_files - 1; i > 0; --i) {
+                std::filesystem::rename(numbered(i), numbered(i + 1), ec);
+            }
+
+            std::filesystem::rename(_path, numbered(1), ec);
+        }
+
+        _open();
+    }
+
+    memory_sink::memory_sink(size_t capacity) : _messages(capacity) { }
+
+    void memory_sink::write(std::span<const std::string_view> messages) {
+        std::unique_lock lock { _mutex };
+        if (_messages.empty()) {
+            return;
+        }
+
+        for (std::string_view msg : messages) {
+            // Reuses the previous allocation of the slot
+            _messages[_next].assign(msg);
+
+            if (++_next == _messages.size()) {
+                _next = 0;
+                _wrapped = true;
+            }
+        }
+    }
+
+    std::vector<std::string> memory_sink::messages() const {
+        std::unique_lock lock { _mutex };
+
+        std::vector<std::string> result;
+        if (_wrapped) {
+            result.assign(_messages.begin() + _next, _messages.end());
+        }
+
+        result.insert(result.end(), _messages.begin(), _messages.begin() + _next);
+        return result;
+    }
+
+    void memory_sink::clear() {
+        std::unique_lock lock { _mutex };
+        _next = 0;
+        _wrapped = false;
+    }
+
+#ifdef _WIN32
+    debug_sink::debug_sink(size_t capacity) : buffered_sink { capacity } { }
+
+    bool debug_sink::accepts_binary() const {
+        // Embedded nulls would cut messages short, and binary data is rarely valid UTF-8
+        return false;
+    }
+
+    void debug_sink::commit(std::string_view data) {
+        // Need std::wstring for null termination
+        OutputDebugStringW(to_utf16(data).c_str());
+    }
+#endif
+}
@@ -14,85 +14,754 @@
     along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
 
 #include "nao/logging.h"
-#include "nao/strings.h"
+#include "nao/log_fields.h"
+#include "nao/log_sink.h"
 
-#include <windows.h>
+#if defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
 
-#include <deque>
-#include <condition_variable>
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Number of messages each thread's log queue can hold, must be a power of 2
+#ifndef NAO_LOG_CAPACITY
+#define NAO_LOG_CAPACITY 2048
+#endif
 
 namespace {
-    void print(const std::string& str) {
-        // Need std::string for null termination
-        OutputDebugStringW(nao::to_utf16(str).c_str());
+    std::unique_ptr<nao::log_sink> default_sink() {
+#ifdef _WIN32
+        return std::make_unique<nao::debug_sink>();
+#else
+        return std::make_unique<nao::stream_sink>(stderr);
+#endif
     }
 
+    /**
+     * Bounded lock-free queue after Dmitry Vyukov's design. Every cell carries a
+     * sequence number telling producers and consumers whose turn it is, so
+     * neither side ever takes a lock. Safe for multiple consumers as well,
+     * which is what allows producers to evict the oldest element. Values stay
+     * in their cells, so their allocations are reused by later elements.
+     */
+    template <typename T>
+    class ring_buffer {
+        static constexpr size_t cache_line = 64;
+
+        struct alignas(cache_line) cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<cell[]> _cells;
+        size_t _mask;
+
+        // Producers and the consumer each get their own cache line
+        alignas(cache_line) std::atomic<size_t> _tail { 0 };
+        alignas(cache_line) std::atomic<size_t> _head { 0 };
+
+        public:
+        explicit ring_buffer(size_t capacity)
+            : _cells { std::make_unique<cell[]>(capacity) }, _mask { capacity - 1 } {
+            for (size_t i = 0; i < capacity; ++i) {
+                _cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief Claims a free cell and lets `func` fill in its value in place.
+         * @return False if the queue is full, `func` is not called.
+         */
+        template <typename Func>
+        bool try_emplace(Func&& func) {
+            size_t pos = _tail.load(std::memory_order_relaxed);
+            while (true) {
+                cell& c = _cells[pos & _mask];
+                size_t seq = c.sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<ptrdiff_t>(seq - pos);
+
+                if (diff == 0) {
+                    if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        // Publish even if func throws, an unpublished cell stalls the queue
+                        struct publisher {
+                            cell& c;
+                            size_t seq;
+                            ~publisher() { c.sequence.store(seq, std::memory_order_release); }
+                        } publish { c, pos + 1 };
+
+                        func(c.value);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = _tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /**
+         * @brief Claims every published element (up to `max`) with a single
+         *        update of the head, then passes them to `func` in order.
+         * @return The number of elements consumed.
+         */
+        template <typename Func>
+        size_t consume(size_t max, Func&& func) {
+            size_t pos = _head.load(std::memory_order_relaxed);
+            size_t count;
+            while (true) {
+                count = 0;
+                while (count < max && _cells[(pos + count) & _mask].sequence.load(
+                    std::memory_order_acquire) == pos + count + 1) {
+                    ++count;
+                }
+
+                if (count == 0) {
+                    return 0;
+                }
+
+                // Fails only if a producer evicted the oldest element meanwhile
+                if (_head.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                cell& c = _cells[(pos + i) & _mask];
+                func(c.value);
+                c.sequence.store(pos + i + _mask + 1, std::memory_order_release);
+            }
+
+            return count;
+        }
+
+        /**
+         * @return Number of elements ever claimed by producers.
+         */
+        size_t tail() const {
+            return _tail.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @return Number of elements ever consumed.
+         */
+        size_t head() const {
+            return _head.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @return Whether the element at the head of the queue is not yet published.
+         */
+        bool empty() const {
+            size_t pos = _head.load(std::memory_order_relaxed);
+            return _cells[pos & _mask].sequence.load(std::memory_order_acquire) != pos + 1;
+        }
+    };
+
+    // Cheap monotonic timestamp used to order messages from different threads
+    uint64_t timestamp() {
+#if defined(_M_X64) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // Converts timestamp() differences to nanoseconds, refined as time passes
+    class tick_calibration {
+        uint64_t _ticks0 = timestamp();
+        std::chrono::steady_clock::time_point _time0 = std::chrono::steady_clock::now();
+        double _ns_per_tick = 0.;
+
+        public:
+        void update() {
+            auto elapsed = std::chrono::steady_clock::now() - _time0;
+            uint64_t ticks = timestamp() - _ticks0;
+
+            // Shorter intervals are dominated by the cost of reading both clocks
+            if (elapsed >= std::chrono::milliseconds { 1 } && ticks > 0) {
+                _ns_per_tick = std::chrono::duration<double, std::nano> { elapsed }.count() / ticks;
+            }
+        }
+
+        bool calibrated() const {
+            return _ns_per_tick > 0.;
+        }
+
+        uint64_t to_ns(uint64_t ticks) const {
+            return static_cast<uint64_t>(ticks * _ns_per_tick);
+        }
+    };
+
+    // A queued message, either text or the captured arguments of a deferred message
+    struct log_record {
+        std::string data;
+        const nao::detail::deferred_format* format = nullptr;
+        uint64_t timestamp = 0;
+
+        // Whether data is already a binary_encoder record
+        bool binary = false;
+    };
+
+    // Queue owned by a single logging thread, only contended with the log thread
+    struct thread_queue {
+        ring_buffer<log_record> ring { NAO_LOG_CAPACITY };
+
+        // Position up to which everything was written, see log_helper::flush
+        std::atomic<size_t> completed { 0 };
+
+        // Set when the owning thread exits, the queue is removed once empty
+        std::atomic<bool> retired { false };
+    };
+
     class log_helper {
-        // All strings to be printed
-        std::deque<std::string> _queue;
-        std::mutex _queue_mutex;
+        static_assert((NAO_LOG_CAPACITY & (NAO_LOG_CAPACITY - 1)) == 0,
+            "NAO_LOG_CAPACITY must be a power of 2");
+
+        // Queues of all threads that have logged something
+        std::mutex _queues_mutex;
+        std::vector<std::shared_ptr<thread_queue>> _queues;
+        std::atomic<uint32_t> _queues_version { 0 };
+
+        std::atomic<nao::log_overflow> _overflow { nao::log_overflow::block };
+
+        // Messages discarded because the queue was full, reported by the log thread
+        std::atomic<uint64_t> _dropped { 0 };
+        uint64_t _dropped_reported = 0;
+
+        // Kept out of _batch, which may grow while _views point into it
+        std::string _dropped_report;
+
+        // Whether messages are wrapped in binary records, as of the current batch
+        bool _binary = false;
+
+        // Text of a deferred message or report, before it is wrapped in a binary record
+        std::string _unframed;
+
+        // Counters for log_stats, only written by the log thread
+        std::atomic<uint64_t> _retired_enqueued { 0 };
+        std::atomic<uint64_t> _written { 0 };
+        std::atomic<uint64_t> _max_batch { 0 };
+        std::atomic<uint64_t> _sink_bytes { 0 };
+        std::atomic<uint64_t> _sink_ns { 0 };
 
-        // Notifies of new strings to be printed
-        std::mutex _condition_mutex;
-        std::condition_variable _condition;
+        // Also counted when replacing the sink, under the sink mutex
+        std::atomic<uint64_t> _sink_errors { 0 };
+        std::array<std::atomic<uint64_t>, nao::log_statistics::latency_buckets> _latency {};
+        tick_calibration _calibration;
 
+        // Set by the log thread right before it goes to sleep
+        std::atomic<bool> _sleeping { false };
+
+        // Producers blocked on a full queue wait for this to change
+        std::atomic<uint32_t> _waiting_producers { 0 };
+        std::atomic<uint32_t> _space_epoch { 0 };
+
+        // Incremented every time the log thread has flushed the sink and updated
+        // the completed position of each queue
+        std::atomic<uint32_t> _completed_epoch { 0 };
+        std::atomic<uint32_t> _flush_waiters { 0 };
+
+        // On stop, messages queued before these positions are still written if _drain is set
+        using queue_positions = std::vector<std::pair<std::shared_ptr<thread_queue>, size_t>>;
+        std::atomic<bool> _drain { true };
+        queue_positions _stop_targets;
         std::atomic<bool> _stop { false };
 
+        // Only held by the log thread while writing, and when replacing the sink
+        std::mutex _sink_mutex;
+        std::unique_ptr<nao::log_sink> _sink = default_sink();
+
+        // Everything below is only used by the log thread
+
+        // Copy of _queues as of _active_version
+        std::vector<std::shared_ptr<thread_queue>> _active;
+        uint32_t _active_version = 0;
+
+        // Messages of one drain of the queues. Strings are swapped with the queues'
+        // so their allocations keep getting reused.
+        std::vector<std::string> _batch;
+        std::vector<uint64_t> _timestamps;
+        std::vector<std::string_view> _views;
+        size_t _batch_size = 0;
+
+        // Range of _batch taken from a single queue, in that queue's order
+        struct run {
+            size_t next;
+            size_t end;
+        };
+        std::vector<run> _runs;
+
         std::thread _log_thread { &log_helper::_log_func, this };
 
         public:
         ~log_helper() {
+            _stop_targets = _positions();
             _stop = true;
-            {
-                std::unique_lock lock { _condition_mutex };
-                _condition.notify_all();
-            }
+            _wake();
 
             if (_log_thread.joinable()) {
                 _log_thread.join();
             }
+
+            std::unique_lock lock { _sink_mutex };
+            _flush_sink();
+        }
+
+        void set_sink(std::unique_ptr<nao::log_sink> sink) {
+            std::unique_lock lock { _sink_mutex };
+            _check_encoding(*sink, nao::detail::structured_encoding.load(std::memory_order_relaxed));
+            _flush_sink();
+            _sink = std::move(sink);
+        }
+
+        // Under the sink mutex, so that the sink and the encoding can't be changed into a mismatch concurrently
+        void set_encoding(nao::log_encoding encoding) {
+            std::unique_lock lock { _sink_mutex };
+            _check_encoding(*_sink, encoding);
+            nao::detail::structured_encoding.store(encoding, std::memory_order_relaxed);
+        }
+
+        void set_overflow(nao::log_overflow policy) {
+            _overflow.store(policy, std::memory_order_relaxed);
         }
 
-        void push(std::string str) {
+        nao::log_statistics stats() {
+            nao::log_statistics stats {};
+            stats.enqueued = _retired_enqueued.load(std::memory_order_relaxed);
+
             {
-                std::unique_lock lock { _queue_mutex };
-                _queue.emplace_back(std::move(str));
+                std::unique_lock lock { _queues_mutex };
+                for (const auto& queue : _queues) {
+                    size_t tail = queue->ring.tail();
+                    stats.enqueued += tail;
+                    stats.queued += tail - std::min(tail, queue->ring.head());
+                }
+            }
+
+            stats.written = _written.load(std::memory_order_relaxed);
+            stats.dropped = _dropped.load(std::memory_order_relaxed);
+            stats.max_batch = _max_batch.load(std::memory_order_relaxed);
+            stats.sink_bytes = _sink_bytes.load(std::memory_order_relaxed);
+            stats.sink_seconds = _sink_ns.load(std::memory_order_relaxed) / 1e9;
+            stats.sink_errors = _sink_errors.load(std::memory_order_relaxed);
+
+            if (stats.sink_seconds > 0.) {
+                stats.sink_bytes_per_second = stats.sink_bytes / stats.sink_seconds;
             }
 
-            std::unique_lock lock { _condition_mutex };
-            _condition.notify_one();
+            for (size_t i = 0; i < stats.latency_ns.size(); ++i) {
+                stats.latency_ns[i] = _latency[i].load(std::memory_order_relaxed);
+            }
+
+            return stats;
+        }
+
+        void set_drain(bool drain) {
+            _drain.store(drain, std::memory_order_relaxed);
         }
 
+        void flush() {
+            queue_positions targets = _positions();
+
+            // Tells the log thread to report progress even while it is busy
+            _flush_waiters.fetch_add(1);
+            _wake();
+
+            while (true) {
+                uint32_t epoch = _completed_epoch.load();
+                if (_reached(targets)) {
+                    break;
+                }
+
+                _completed_epoch.wait(epoch);
+            }
+
+            _flush_waiters.fetch_sub(1);
+        }
+
+        void push(std::string_view str, const nao::detail::deferred_format* format = nullptr, bool binary = false) {
+            uint64_t now = timestamp();
+
+            // Assigning reuses the allocation left in the cell by earlier messages
+            auto fill = [str, format, now, binary](log_record& record) {
+                record.data.assign(str);
+                record.format = format;
+                record.timestamp = now;
+                record.binary = binary;
+            };
+
+            ring_buffer<log_record>& queue = _local_queue().ring;
+            if (!queue.try_emplace(fill)) {
+                _push_full(queue, fill);
+            }
+
+            // Pairs with the fence in _log_func, either we see the log thread
+            // going to sleep or it sees our message.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_sleeping.load(std::memory_order_relaxed)) {
+                _wake();
+            }
+        }
 
         private:
+        void _wake() {
+            if (_sleeping.exchange(false)) {
+                _sleeping.notify_one();
+            }
+        }
+
+        thread_queue& _local_queue() {
+            // Registers the calling thread's queue on first use, retires it on thread exit
+            struct handle {
+                std::shared_ptr<thread_queue> queue = std::make_shared<thread_queue>();
+
+                explicit handle(log_helper& log) {
+                    std::unique_lock lock { log._queues_mutex };
+                    log._queues.push_back(queue);
+                    log._queues_version.fetch_add(1);
+                }
+
+                ~handle() {
+                    queue->retired = true;
+                }
+            };
+
+            thread_local handle local { *this };
+            return *local.queue;
+        }
+
+        // Current tail of every queue
+        queue_positions _positions() {
+            std::unique_lock lock { _queues_mutex };
+
+            queue_positions positions;
+            positions.reserve(_queues.size());
+            for (const auto& queue : _queues) {
+                positions.emplace_back(queue, queue->ring.tail());
+            }
+
+            return positions;
+        }
+
+        static bool _reached(const queue_positions& targets) {
+            return std::ranges::all_of(targets, [](const auto& target) {
+                return target.first->completed.load() >= target.second;
+            });
+        }
+
+        template <typename Func>
+        void _push_full(ring_buffer<log_record>& queue, Func& fill) {
+            switch (_overflow.load(std::memory_order_relaxed)) {
+                case nao::log_overflow::drop_newest:
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+
+                case nao::log_overflow::drop_oldest:
+                    while (!queue.try_emplace(fill)) {
+                        if (queue.consume(1, [](log_record&) { }) > 0) {
+                            _dropped.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }
+                    return;
+
+                case nao::log_overflow::block:
+                default:
+                    _waiting_producers.fetch_add(1);
+                    while (true) {
+                        uint32_t epoch = _space_epoch.load();
+                        if (queue.try_emplace(fill)) {
+                            break;
+                        }
+
+                        // The log thread may be asleep from before the queue filled up
+                        _wake();
+                        _space_epoch.wait(epoch);
+                    }
+                    _waiting_producers.fetch_sub(1);
+                    return;
+            }
+        }
+
+        std::string& _batch_slot() {
+            if (_batch_size == _batch.size()) {
+                _batch.emplace_back();
+                _timestamps.emplace_back();
+            }
+
+            return _batch[_batch_size++];
+        }
+
+        // Picks up newly registered queues
+        void _refresh_queues() {
+            uint32_t version = _queues_version.load();
+            if (version != _active_version) {
+                std::unique_lock lock { _queues_mutex };
+                _active = _queues;
+                _active_version = version;
+            }
+        }
+
+        // Forgets retired queues once they are empty, only after their completed position is published
+        void _remove_retired() {
+            auto drained = [](const std::shared_ptr<thread_queue>& queue) {
+                return queue->retired && queue->ring.head() == queue->ring.tail();
+            };
+
+            if (std::ranges::any_of(_active, drained)) {
+                std::unique_lock lock { _queues_mutex };
+                std::erase_if(_queues, [this, &drained](const std::shared_ptr<thread_queue>& queue) {
+                    if (drained(queue)) {
+                        _retired_enqueued.fetch_add(queue->ring.tail(), std::memory_order_relaxed);
+                        return true;
+                    }
+
+                    return false;
+                    });
+                _active = _queues;
+                _active_version = _queues_version.fetch_add(1) + 1;
+            }
+        }
+
+        // Wraps text in a binary record, so that it can be told apart from the structured records around it
+        static void _frame(std::string& out, nao::log_level level, std::string_view text) {
+            nao::binary_encoder { out, level, {}, text }.finish();
+        }
+
+        // Takes everything currently queued, returns the number of messages taken
+        size_t _consume() {
+            _refresh_queues();
+            _runs.clear();
+            _binary = nao::detail::structured_encoding.load(std::memory_order_relaxed) == nao::log_encoding::binary;
+
+            size_t total = 0;
+            for (const auto& queue : _active) {
+                size_t begin = _batch_size;
+                size_t count = queue->ring.consume(NAO_LOG_CAPACITY, [this](log_record& record) {
+                    std::string& slot = _batch_slot();
+                    slot.clear();
+                    _timestamps[_batch_size - 1] = record.timestamp;
+
+                    if (!_binary || record.binary) {
+                        if (record.format) {
+                            record.format->decode(slot, record.format->fmt, record.data.data());
+                        } else {
+                            slot.swap(record.data);
+                        }
+                    } else if (record.format) {
+                        _unframed.clear();
+                        record.format->decode(_unframed, record.format->fmt, record.data.data());
+                        _frame(slot, nao::log_level::off, _unframed);
+                    } else {
+                        _frame(slot, nao::log_level::off, record.data);
+                    }
+                    });
+
+                if (count > 0) {
+                    _runs.push_back({ begin, begin + count });
+                    total += count;
+                }
+            }
+
+            return total;
+        }
+
+        // Merges the runs by timestamp, keeping each thread's own order intact
+        void _merge() {
+            _views.clear();
+
+            auto later = [this](const run& lhs, const run& rhs) {
+                return _timestamps[lhs.next] > _timestamps[rhs.next];
+            };
+
+            std::ranges::make_heap(_runs, later);
+            while (!_runs.empty()) {
+                std::ranges::pop_heap(_runs, later);
+                run& next = _runs.back();
+                _views.emplace_back(_batch[next.next]);
+
+                if (++next.next == next.end) {
+                    _runs.pop_back();
+                } else {
+                    std::ranges::push_heap(_runs, later);
+                }
+            }
+        }
+
+        void _report_dropped() {
+            uint64_t total = _dropped.load(std::memory_order_relaxed);
+            if (total != _dropped_reported) {
+                uint64_t dropped = total - _dropped_reported;
+                _dropped_reported = total;
+                _unframed.assign("[nao::cout] dropped ").append(std::to_string(dropped)).append(" messages\n");
+
+                _dropped_report.clear();
+                if (_binary) {
+                    _frame(_dropped_report, nao::log_level::warn, _unframed);
+                } else {
+                    _dropped_report.append(_unframed);
+                }
+
+                _views.emplace_back(_dropped_report);
+            }
+        }
+
+        void _write_batch() {
+            auto start = std::chrono::steady_clock::now();
+            {
+                std::unique_lock lock { _sink_mutex };
+                try {
+                    _sink->write(_views);
+                } catch (...) {
+                    // Losing the batch beats taking the process down with the log thread
+                    _sink_errors.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            _record_sink_time(start);
+
+            size_t bytes = 0;
+            for (std::string_view view : _views) {
+                bytes += view.size();
+            }
+
+            _add(_sink_bytes, bytes);
+            _batch_size = 0;
+        }
+
+        // Needs the sink mutex, also called from other threads when replacing the sink
+        void _flush_sink() {
+            try {
+                _sink->flush();
+            } catch (...) {
+                _sink_errors.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        static void _check_encoding(const nao::log_sink& sink, nao::log_encoding encoding) {
+            if (encoding == nao::log_encoding::binary && !sink.accepts_binary()) {
+                throw std::runtime_error("binary log encoding needs a sink that accepts binary data");
+            }
+        }
+
+        // Only the log thread writes the counters, so no read-modify-write is needed
+        static void _add(std::atomic<uint64_t>& counter, uint64_t value) {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        void _record_sink_time(std::chrono::steady_clock::time_point start) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            _add(_sink_ns, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+
+        // Records how long the first `count` messages in _batch took from being logged to being written
+        void _record_written(size_t count) {
+            _add(_written, count);
+
+            if (count > _max_batch.load(std::memory_order_relaxed)) {
+                _max_batch.store(count, std::memory_order_relaxed);
+            }
+
+            _calibration.update();
+            if (!_calibration.calibrated()) {
+                return;
+            }
+
+            uint64_t now = timestamp();
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t ns = _calibration.to_ns(now - std::min(now, _timestamps[i]));
+                size_t bucket = std::min<size_t>(std::bit_width(ns), _latency.size() - 1);
+                _add(_latency[bucket], 1);
+            }
+        }
+
+        // Flushes the sink and reports everything consumed so far as complete
+        void _complete() {
+            auto start = std::chrono::steady_clock::now();
+            {
+                std::unique_lock lock { _sink_mutex };
+                _flush_sink();
+            }
+
+            _record_sink_time(start);
+
+            // Anything below the head has been written by us or dropped by a producer
+            for (const auto& queue : _active) {
+                queue->completed.store(queue->ring.head());
+            }
+
+            _completed_epoch.fetch_add(1);
+            _completed_epoch.notify_all();
+
+            _remove_retired();
+        }
+
+        bool _done() const {
+            return _stop && (!_drain.load(std::memory_order_relaxed) || _reached(_stop_targets));
+        }
+
+        bool _empty() const {
+            return std::ranges::all_of(_active, [](const auto& queue) { return queue->ring.empty(); });
+        }
+
         void _log_func() {
-            // Fallthrough to wait immediately
-            bool is_empty = true;
             while (true) {
-                // Print elements if there are any
-                while (!is_empty) {
-                    std::unique_lock lock { _queue_mutex };
-                    print(_queue.front());
-                    _queue.pop_front();
-
-                    if (_stop) {
-                        return;
+                // Take everything that is queued and write it out in one go
+                size_t count = _consume();
+
+                if (count > 0) {
+                    // Pairs with the waiting producer's increment
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (_waiting_producers.load(std::memory_order_relaxed) > 0) {
+                        _space_epoch.fetch_add(1);
+                        _space_epoch.notify_all();
                     }
+                }
+
+                _merge();
+                _report_dropped();
 
-                    is_empty = _queue.empty();
+                if (!_views.empty()) {
+                    _write_batch();
+                    _record_written(count);
                 }
 
-                // Else wait for a notification
-                std::unique_lock lock { _condition_mutex };
-                _condition.wait(lock, [this, &is_empty] {
-                    is_empty = _queue.empty();
-                    return !is_empty || _stop;
-                    });
+                // Out of work, so make sure nothing lingers in the sink's buffer
+                if (count == 0 || _flush_waiters.load() > 0 || _stop) {
+                    _complete();
+                }
 
-                if (_stop) {
+                if (_done()) {
                     return;
                 }
+
+                if (count > 0) {
+                    continue;
+                }
+
+                // Else go to sleep, unless a message arrived in the meantime. Pending flushes
+                // need no check, everything consumed was just completed. Spinning for them
+                // would starve the flushing thread of a CPU it may share with us.
+                _sleeping.store(true);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (_queues_version.load() != _active_version || !_empty() || _stop) {
+                    _sleeping.store(false);
+                    continue;
+                }
+
+                _sleeping.wait(true);
             }
         }
     };
@@ -104,7 +773,145 @@ namespace {
 }
 
 namespace nao {
+    namespace detail {
+        void log_write(std::string_view str) {
+            logger().push(str);
+        }
+
+        void log_write_deferred(const deferred_format& format, std::string_view args) {
+            logger().push(args, &format);
+        }
+
+        void log_write_binary(std::string_view record) {
+            logger().push(record, nullptr, true);
+        }
+    }
+
     void cout(std::string str) {
-        logger().push(std::move(str));
+        logger().push(str);
+    }
+
+    void set_log_overflow(log_overflow policy) {
+        logger().set_overflow(policy);
+    }
+
+    void set_log_sink(std::unique_ptr<log_sink> sink) {
+        logger().set_sink(std::move(sink));
+    }
+
+    void set_log_drain_on_exit(bool drain) {
+        logger().set_drain(drain);
+    }
+
+    void flush() {
+        logger().flush();
+    }
+
+    log_statistics log_stats() {
+        return logger().stats();
+    }
+}
+
+namespace nao {
+    namespace detail {
+        std::atomic<log_level> log_threshold { log_level::info };
+        std::atomic<log_encoding> structured_encoding { log_encoding::json };
+    }
+
+    void set_log_encoding(log_encoding encoding) {
+        logger().set_encoding(encoding);
+    }
+
+    /**
+     * Keeps track of all live categories, so that changing the global level
+     * only costs the categories following it a single store.
+     */
+    class log_category_registry {
+        std::mutex _mutex;
+        std::vector<log_category*> _categories;
+        std::map<std::string, log_level, std::less<>> _overrides;
+
+        public:
+        static log_category_registry& instance() {
+            static log_category_registry registry;
+            return registry;
+        }
+
+        void add(log_category* category) {
+            std::unique_lock lock { _mutex };
+            _categories.push_back(category);
+
+            auto it = _overrides.find(category->name());
+            category->_overridden = (it != _overrides.end());
+            category->_level.store(category->_overridden ? it->second
+                : detail::log_threshold.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        void remove(log_category* category) {
+            std::unique_lock lock { _mutex };
+            std::erase(_categories, category);
+        }
+
+        void set_global(log_level level) {
+            std::unique_lock lock { _mutex };
+            detail::log_threshold.store(level, std::memory_order_relaxed);
+
+            for (log_category* category : _categories) {
+                if (!category->_overridden) {
+                    category->_level.store(level, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        void set(std::string_view name, log_level level) {
+            std::unique_lock lock { _mutex };
+            _overrides.insert_or_assign(std::string { name }, level);
+
+            for (log_category* category : _categories) {
+                if (category->name() == name) {
+                    category->_overridden = true;
+                    category->_level.store(level, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        void reset(std::string_view name) {
+            std::unique_lock lock { _mutex };
+            if (auto it = _overrides.find(name); it != _overrides.end()) {
+                _overrides.erase(it);
+            }
+
+            for (log_category* category : _categories) {
+                if (category->name() == name) {
+                    category->_overridden = false;
+                    category->_level.store(detail::log_threshold.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+                }
+            }
+        }
+    };
+
+    log_category::log_category(std::string_view name) : _name { name }, _level { log_level::info } {
+        log_category_registry::instance().add(this);
+    }
+
+    log_category::~log_category() {
+        log_category_registry::instance().remove(this);
+    }
+
+    void set_log_level(log_level level) {
+        log_category_registry::instance().set_global(level);
+    }
+
+    void set_log_level(std::string_view category, log_level level) {
+        log_category_registry::instance().set(category, level);
+    }
+
+    void reset_log_level(std::string_view category) {
+        log_category_registry::instance().reset(category);
+    }
+
+    log_level get_log_level() {
+        return detail::log_threshold.load(std::memory_order_relaxed);
     }
 }
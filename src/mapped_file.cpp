@@ -0,0 +1,154 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "nao/mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stdexcept>
+#include <utility>
+
+namespace {
+#ifdef _WIN32
+    // Simple auto-destructor
+    struct handle_lock {
+        HANDLE handle = nullptr;
+        ~handle_lock() {
+            if (handle && handle != INVALID_HANDLE_VALUE) {
+                CloseHandle(handle);
+            }
+        }
+    };
+#else
+    struct fd_lock {
+        int fd = -1;
+        ~fd_lock() {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    };
+#endif
+
+    [[noreturn]] void throw_mapping_failed(const std::filesystem::path& path) {
+        throw std::runtime_error("failed mapping file " + path.string());
+    }
+}
+
+namespace nao {
+#ifdef _WIN32
+    mapped_file::mapped_file(const std::filesystem::path& path) {
+        handle_lock file { CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+
+        if (file.handle == INVALID_HANDLE_VALUE) {
+            throw_mapping_failed(path);
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file.handle, &size)) {
+            throw_mapping_failed(path);
+        }
+
+        if (size.QuadPart == 0) {
+            return;
+        }
+
+        // The view keeps the mapping and the file open by itself
+        handle_lock mapping { CreateFileMappingW(file.handle, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+        if (!mapping.handle) {
+            throw_mapping_failed(path);
+        }
+
+        void* view = MapViewOfFile(mapping.handle, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            throw_mapping_failed(path);
+        }
+
+        _data = static_cast<const char*>(view);
+        _size = static_cast<size_t>(size.QuadPart);
+    }
+
+    void mapped_file::close() noexcept {
+        if (_data) {
+            UnmapViewOfFile(_data);
+        }
+
+        _data = nullptr;
+        _size = 0;
+    }
+#else
+    mapped_file::mapped_file(const std::filesystem::path& path) {
+        fd_lock file { ::open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+        if (file.fd < 0) {
+            throw_mapping_failed(path);
+        }
+
+        struct stat st;
+        if (fstat(file.fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            throw_mapping_failed(path);
+        }
+
+        if (st.st_size == 0) {
+            return;
+        }
+
+        // The mapping keeps the file open by itself
+        void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, file.fd, 0);
+        if (view == MAP_FAILED) {
+            throw_mapping_failed(path);
+        }
+
+        // Parsers read front to back, let the kernel read ahead
+        madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+        _data = static_cast<const char*>(view);
+        _size = static_cast<size_t>(st.st_size);
+    }
+
+    void mapped_file::close() noexcept {
+        if (_data) {
+            munmap(const_cast<char*>(_data), _size);
+        }
+
+        _data = nullptr;
+        _size = 0;
+    }
+#endif
+
+    mapped_file::~mapped_file() {
+        close();
+    }
+
+    mapped_file::mapped_file(mapped_file&& other) noexcept
+        : _data { std::exchange(other._data, nullptr) }, _size { std::exchange(other._size, 0) } { }
+
+    mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+        if (this != &other) {
+            close();
+            _data = std::exchange(other._data, nullptr);
+            _size = std::exchange(other._size, 0);
+        }
+
+        return *this;
+    }
+}
@@ -0,0 +1,138 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "nao/progress.h"
+
+#include "nao/logging.h"
+#include "nao/strings.h"
+
+#include <cmath>
+
+namespace {
+    // Rates fluctuate, so only the leading digits are shown
+    constexpr nao::unit_format rate_format { "B/s", "B/s", nao::unit_system::iec, 0, 3 };
+}
+
+namespace nao {
+    progress::progress(uint64_t total, progress_options options)
+        : _total { total }, _options { std::move(options) } {
+        _reporter = std::thread { &progress::_report_func, this };
+    }
+
+    progress::~progress() {
+        finish();
+    }
+
+    void progress::_report_func() {
+        using clock = std::chrono::steady_clock;
+
+        auto start = clock::now();
+        auto last_time = start;
+        uint64_t last_done = _done.load(std::memory_order_relaxed);
+        double smoothing = std::chrono::duration<double>(_options.smoothing).count();
+        bool first = true;
+
+        std::unique_lock lock { _mutex };
+        while (!_cv.wait_for(lock, _options.interval, [this] { return _stop; })) {
+            auto now = clock::now();
+            uint64_t done = _done.load(std::memory_order_relaxed);
+            double elapsed = std::chrono::duration<double>(now - last_time).count();
+            double instant = static_cast<double>(done - last_done) / elapsed;
+
+            // Weighted by the time that passed, so late wakeups do not skew the average
+            double rate = instant;
+            if (!first) {
+                double weight = 1. - std::exp(-elapsed / smoothing);
+                rate = weight * instant + (1. - weight) * _rate.load(std::memory_order_relaxed);
+            }
+
+            _rate.store(rate, std::memory_order_relaxed);
+            first = false;
+            last_time = now;
+            last_done = done;
+
+            lock.unlock();
+            cout(_line(done, total(), rate) + '\n');
+            lock.lock();
+        }
+
+        // The final line reports the average over the whole transfer
+        double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        uint64_t done = _done.load(std::memory_order_relaxed);
+        if (elapsed > 0.) {
+            _rate.store(static_cast<double>(done) / elapsed, std::memory_order_relaxed);
+        }
+    }
+
+    std::string progress::_line(uint64_t done, uint64_t total, double rate) const {
+        std::string result;
+        if (!_options.label.empty()) {
+            result.append(_options.label).append(": ");
+        }
+
+        result.append(to_inline_string(byte_size { done }).view());
+
+        if (total > 0) {
+            result.append(" / ").append(to_inline_string(byte_size { total }).view())
+                .append(" (").append(to_inline_string(percentage { static_cast<double>(done) / static_cast<double>(total) }).view())
+                .append(")");
+        }
+
+        result.append(" at ").append(to_inline_string(unit_value { static_cast<uint64_t>(rate), rate_format }).view());
+
+        if (total > done && rate >= 1.) {
+            auto eta = static_cast<uint64_t>(static_cast<double>(total - done) / rate * 1e9);
+            time_unit largest = eta >= 3'600'000'000'000 ? time_unit::hours : time_unit::minutes;
+            result.append(", ETA ").append(to_inline_string(clock_time { eta, { largest, 0 } }).view());
+        }
+
+        return result;
+    }
+
+    void progress::set_total(uint64_t total) noexcept {
+        _total.store(total, std::memory_order_relaxed);
+    }
+
+    uint64_t progress::done() const noexcept {
+        return _done.load(std::memory_order_relaxed);
+    }
+
+    uint64_t progress::total() const noexcept {
+        return _total.load(std::memory_order_relaxed);
+    }
+
+    double progress::rate() const noexcept {
+        return _rate.load(std::memory_order_relaxed);
+    }
+
+    std::string progress::line() const {
+        return _line(done(), total(), rate());
+    }
+
+    void progress::finish() {
+        {
+            std::scoped_lock lock { _mutex };
+            if (_stop) {
+                return;
+            }
+
+            _stop = true;
+        }
+
+        _cv.notify_one();
+        _reporter.join();
+        cout(line() + '\n');
+    }
+}
@@ -16,11 +16,14 @@
 #define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
 
 #include "nao/steam.h"
+#include "nao/mapped_file.h"
 #include "nao/strings.h"
 
 #include <windows.h>
 
+#include <charconv>
 #include <filesystem>
+#include <optional>
 #include <stdexcept>
 
 #include "vdf_parser.h"
@@ -35,6 +38,71 @@ namespace {
             }
         }
     };
+
+    /*
+     * Collects the numbered libraries of libraryfolders.vdf's root, "1" being the first one
+     * besides Steam's own folder. Older files have the path as the value, newer ones have
+     * an object holding a "path" attribute, and list Steam's own folder as "0".
+     */
+    struct library_folders {
+        std::vector<std::string> paths;
+        size_t depth = 0;
+
+        // Index into paths of the library object being read, if any
+        std::optional<size_t> folder;
+
+        bool on_object_begin(std::string_view name) {
+            if (++depth == 2) {
+                folder = _slot(name);
+            }
+
+            return true;
+        }
+
+        bool on_key_value(std::string_view key, std::string_view value) {
+            if (depth == 1) {
+                if (auto slot = _slot(key)) {
+                    paths[*slot] = value;
+                }
+            } else if (depth == 2 && folder && key == "path") {
+                paths[*folder] = value;
+            }
+
+            return true;
+        }
+
+        // Nothing of interest follows the root object
+        bool on_object_end() {
+            if (depth == 2) {
+                folder.reset();
+            }
+
+            return --depth > 0;
+        }
+
+        private:
+        /*
+         * Makes room for the library numbered by key, if it is one. Libraries are numbered
+         * in order, so a number past the next one means the file is broken.
+         */
+        std::optional<size_t> _slot(std::string_view key) {
+            size_t index;
+            auto [ptr, ec] = std::from_chars(key.data(), key.data() + key.size(), index);
+            if (ec != std::errc {} || ptr != key.data() + key.size() || index == 0) {
+                return std::nullopt;
+            }
+
+            if (index > paths.size() + 1) {
+                throw std::runtime_error(__FUNCTION__": Library folder out of order");
+            }
+
+            if (paths.size() < index) {
+                paths.resize(index);
+            }
+
+            return index - 1;
+        }
+    };
 }
 
 namespace nao::steam {
@@ -80,19 +148,17 @@ namespace nao::steam {
         auto vdf_path = std::filesystem::path {
             (path() + "\\SteamApps\\libraryfolders.vdf").c_str() }.lexically_normal();
 
-        std::ifstream in { vdf_path };
-        tyti::vdf::object root = tyti::vdf::read(in);
+        nao::mapped_file file { vdf_path };
+        library_folders libraries;
+        tyti::vdf::parse(file.begin(), file.end(), libraries);
 
-        std::vector<std::string> folders { root.attribs.size() - 1 };
-
-        folders[0] = path();
-
-        auto transform = [](const auto& path) {
-            return std::filesystem::absolute(path.c_str()).lexically_normal().string();
-        };
+        std::vector<std::string> folders { path() };
+        for (const std::string& folder : libraries.paths) {
+            if (folder.empty()) {
+                throw std::runtime_error(__FUNCTION__": Missing library folder");
+            }
 
-        for (size_t i = 1; i < folders.size(); ++i) {
-            folders[i] = transform(root.attribs.at(std::to_string(i)));
+            folders.push_back(std::filesystem::absolute(folder).lexically_normal().string());
         }
 
         return folders;
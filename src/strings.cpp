@@ -15,176 +15,351 @@
 
 #include "nao/strings.h"
 
-#include <windows.h>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <span>
+
+namespace {
+    using formatted = char[nao::formatted_size_max];
+
+    char* append(char* out, std::string_view str) {
+        std::memcpy(out, str.data(), str.size());
+        return out + str.size();
+    }
 
-#include <sstream>
-#include <iomanip>
-#include <chrono>
+    template <typename T>
+    char* append_int(char* out, T v) {
+        return std::to_chars(out, out + std::numeric_limits<T>::digits10 + 2, v).ptr;
+    }
 
-namespace nao {
-    std::string bytes(size_t n) {
-        std::stringstream ss;
-        ss << std::setprecision(3) << std::fixed;
-
-        std::string_view suffix;
-        if (n > 0x1000000000000000) {
-            ss << ((n >> 50) / 1024.);
-            suffix = "EiB";
-        } else if (n > 0x4000000000000) {
-            ss << ((n >> 40) / 1024.L);
-            suffix = "PiB";
-        } else if (n > 0x10000000000) {
-            ss << ((n >> 30) / 1024.);
-            suffix = "TiB";
-        } else if (n > 0x40000000) {
-            ss << ((n >> 20) / 1024.);
-            suffix = "GiB";
-        } else if (n > 0x100000) {
-            ss << ((n >> 10) / 1024.);
-            suffix = "MiB";
-        } else if (n > 0x400) {
-            ss << (n / 1024.);
-            suffix = "KiB";
-        } else {
-            ss << n;
-            suffix = "bytes";
+    /**
+     * @brief Writes `v` zero-padded to `width` digits.
+     */
+    char* append_padded(char* out, uint64_t v, int width) {
+        for (int i = width - 1; i >= 0; --i) {
+            out[i] = static_cast<char>('0' + (v % 10));
+            v /= 10;
         }
 
-        // Remove trailing whitespace and zeroes
-        std::string s = ss.str();
-
-        // string_view does not support operator+
-        // https://stackoverflow.com/a/47735624/8662472
-        return (s.erase(s.find_last_not_of("0.") + 1) + ' ').append(suffix);
+        return out + width;
     }
 
-    std::string bits(size_t n) {
-        std::stringstream ss;
-        ss << std::setprecision(3) << std::fixed;
-
-        std::string_view suffix;
-        if (n > 0x1000000000000000) {
-            ss << ((n >> 50) / 1024.);
-            suffix = "Eibit";
-        } else if (n > 0x4000000000000) {
-            ss << ((n >> 40) / 1024.L);
-            suffix = "Pibit";
-        } else if (n > 0x10000000000) {
-            ss << ((n >> 30) / 1024.);
-            suffix = "Tibit";
-        } else if (n > 0x40000000) {
-            ss << ((n >> 20) / 1024.);
-            suffix = "Gibit";
-        } else if (n > 0x100000) {
-            ss << ((n >> 10) / 1024.);
-            suffix = "Mibit";
-        } else if (n > 0x400) {
-            ss << (n / 1024.);
-            suffix = "Kibit";
-        } else {
-            ss << n;
-            suffix = "bits";
+    constexpr size_t max_unit = 6;
+
+    constexpr std::string_view iec_prefixes[max_unit + 1] { "", "Ki", "Mi", "Gi", "Ti", "Pi", "Ei" };
+    constexpr std::string_view si_prefixes[max_unit + 1] { "", "k", "M", "G", "T", "P", "E" };
+
+    constexpr auto powers_of_10 = [] {
+        std::array<uint64_t, 20> res {};
+        res[0] = 1;
+        for (size_t i = 1; i < res.size(); ++i) {
+            res[i] = res[i - 1] * 10;
         }
 
-        // Remove trailing whitespace and zeroes
-        std::string s = ss.str();
+        return res;
+        }();
 
-        // string_view does not support operator+
-        // https://stackoverflow.com/a/47735624/8662472
-        return (s.erase(s.find_last_not_of("0.") + 1) + ' ').append(suffix);
+    constexpr uint64_t pow10(int n) {
+        return powers_of_10[n];
     }
 
-    std::string percent(double v) {
-        return std::to_string(static_cast<int64_t>(round(v * 100.))) + '%';
+    /**
+     * @brief Count at which each SI prefix starts, 0 for the unprefixed unit.
+     */
+    constexpr auto si_thresholds = [] {
+        std::array<uint64_t, max_unit + 1> res {};
+        for (size_t i = 1; i <= max_unit; ++i) {
+            res[i] = pow10(static_cast<int>(3 * i));
+        }
+
+        return res;
+        }();
+
+    /**
+     * @brief For each bit length, the largest SI prefix a count of that length can reach.
+     */
+    constexpr auto si_by_length = [] {
+        std::array<uint8_t, 65> res {};
+        for (int length = 1; length <= 64; ++length) {
+            uint64_t largest = length == 64 ? ~uint64_t { 0 } : (uint64_t { 1 } << length) - 1;
+            uint8_t unit = 0;
+            while (unit < max_unit && si_thresholds[unit + 1] <= largest) {
+                ++unit;
+            }
+
+            res[length] = unit;
+        }
+
+        return res;
+        }();
+
+    /**
+     * @brief Index of the largest prefix `n` reaches, without looping over the prefixes.
+     */
+    constexpr size_t pick_unit(uint64_t n, nao::unit_system system) {
+        int length = 64 - std::countl_zero(n);
+        if (system == nao::unit_system::iec) {
+            return length == 0 ? 0 : (length - 1) / 10;
+        }
+
+        // Lengths are at most one prefix off
+        size_t unit = si_by_length[length];
+        return unit - (n < si_thresholds[unit]);
     }
 
-    std::string time_hours(uint64_t nanoseconds, bool add_ms) {
-        std::stringstream ss;
-        ss.fill('0');
+    static_assert(pick_unit(1023, nao::unit_system::iec) == 0 && pick_unit(1024, nao::unit_system::iec) == 1);
+    static_assert(pick_unit(999, nao::unit_system::si) == 0 && pick_unit(1000, nao::unit_system::si) == 1);
+    static_assert(pick_unit(~uint64_t { 0 }, nao::unit_system::si) == 6);
 
-        std::chrono::nanoseconds ns { nanoseconds };
+    int digit_count(uint64_t v) {
+        int res = 1;
+        while (v >= 10) {
+            v /= 10;
+            ++res;
+        }
 
-        auto hours = std::chrono::duration_cast<std::chrono::hours>(ns);
-        ns -= hours;
-        auto minutes = std::chrono::duration_cast<std::chrono::minutes>(ns);
-        ns -= minutes;
-        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(ns);
+        return res;
+    }
 
+    /**
+     * @brief The first `decimals` digits of a fraction, rounded half to even.
+     */
+    struct fraction_digits {
+        uint64_t digits;
 
-        ss << hours.count() << ':'
-            << std::setw(2)
-            << minutes.count() << ':'
-            << seconds.count();
+        // The rest compared to half of the last digit
+        int rest;
 
-        if (add_ms) {
-            ns -= seconds;
-            auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(ns);
+        /**
+         * @param odd - Whether the last digit kept is odd, which is in the integer part without decimals.
+         */
+        uint64_t rounded(bool odd) const {
+            return digits + (rest > 0 || (rest == 0 && odd));
+        }
+    };
+
+    /**
+     * @brief Decimals of rem / 2^shift, with shift in [10, 60] and decimals at most 9.
+     */
+    fraction_digits binary_fraction(uint64_t rem, int shift, int decimals) {
+        // rem * 10^decimals needs up to 90 bits, multiply in two halves
+        uint64_t scale = pow10(decimals);
+        uint64_t lo = (rem & 0xFFFFFFFF) * scale;
+        uint64_t hi = (rem >> 32) * scale;
+        uint64_t low64 = lo + (hi << 32);
+        uint64_t high64 = (hi >> 32) + (low64 < lo);
+
+        uint64_t mask = (uint64_t { 1 } << shift) - 1;
+        uint64_t half = uint64_t { 1 } << (shift - 1);
+        uint64_t left = low64 & mask;
+        return { (high64 << (64 - shift)) | (low64 >> shift), (left > half) - (left < half) };
+    }
 
-            ss << '.' << std::setw(3) << milliseconds.count();
+    /**
+     * @brief Decimals of rem / 10^exponent.
+     */
+    fraction_digits decimal_fraction(uint64_t rem, int exponent, int decimals) {
+        if (decimals >= exponent) {
+            return { rem * pow10(decimals - exponent), -1 };
         }
 
-        return ss.str();
+        uint64_t divisor = pow10(exponent - decimals);
+        uint64_t left = rem % divisor;
+        return { rem / divisor, (2 * left > divisor) - (2 * left < divisor) };
     }
 
-    std::string time_minutes(uint64_t nanoseconds, bool add_ms) {
-        std::stringstream ss;
-        ss.fill('0');
+    /**
+     * @brief Writes the number part of `n` scaled to its prefix.
+     * @param unit - Receives the index of the chosen prefix.
+     */
+    size_t format_scaled(char* buf, uint64_t n, const nao::unit_format& format, size_t& unit) {
+        char* out = buf;
+        unit = pick_unit(n, format.system);
 
-        std::chrono::nanoseconds ns { nanoseconds };
+        if (unit == 0) {
+            return append_int(out, n) - buf;
+        }
 
-        auto minutes = std::chrono::duration_cast<std::chrono::minutes>(ns);
-        ns -= minutes;
-        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(ns);
-        ss << minutes.count() << ':'
-            << std::setw(2) << seconds.count();
+        bool iec = format.system == nao::unit_system::iec;
+        uint64_t whole;
+        uint64_t digits;
+        int decimals;
+
+        while (true) {
+            fraction_digits frac;
+            if (iec) {
+                int shift = static_cast<int>(10 * unit);
+                whole = n >> shift;
+                decimals = format.significant ? std::max(format.significant - digit_count(whole), 0) : format.decimals;
+                decimals = std::min(decimals, 9);
+                frac = binary_fraction(n & ((uint64_t { 1 } << shift) - 1), shift, decimals);
+            } else {
+                uint64_t divisor = si_thresholds[unit];
+                whole = n / divisor;
+                decimals = format.significant ? std::max(format.significant - digit_count(whole), 0) : format.decimals;
+                decimals = std::min(decimals, 9);
+                frac = decimal_fraction(n % divisor, static_cast<int>(3 * unit), decimals);
+            }
+
+            digits = frac.rounded(decimals > 0 ? (frac.digits & 1) : (whole & 1));
+            if (digits == pow10(decimals)) {
+                ++whole;
+                digits = 0;
+            }
+
+            // Rounded up to the next prefix, 1023.9996 KiB is 1 MiB
+            if (whole == (iec ? 1024u : 1000u) && unit < max_unit) {
+                ++unit;
+                continue;
+            }
+
+            break;
+        }
 
-        if (add_ms) {
-            ns -= seconds;
-            auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(ns);
+        out = append_int(out, whole);
+        if (decimals > 0) {
+            char* point = out;
+            *out++ = '.';
+            out = append_padded(out, digits, decimals);
+
+            if (format.trim) {
+                while (out[-1] == '0') {
+                    --out;
+                }
+
+                if (out == point + 1) {
+                    out = point;
+                }
+            }
+        }
+
+        return out - buf;
+    }
+
+    /**
+     * @brief The text following the number of a formatted unit_value.
+     */
+    struct unit_name {
+        std::string_view prefix;
+        std::string_view unit;
+
+        size_t size() const {
+            return 1 + prefix.size() + unit.size();
+        }
+
+        char* append_to(char* out) const {
+            *out++ = ' ';
+            out = append(out, prefix);
+            return append(out, unit);
+        }
+    };
 
-            ss << '.' << std::setw(3) << milliseconds.count();
+    unit_name name_of(const nao::unit_format& format, size_t unit) {
+        if (unit == 0) {
+            return { {}, format.unscaled };
         }
 
-        return ss.str();
+        return { (format.system == nao::unit_system::iec ? iec_prefixes : si_prefixes)[unit], format.unit };
     }
 
-    std::wstring to_utf16(std::string_view str) {
-        int size = MultiByteToWideChar(
-            CP_UTF8, MB_ERR_INVALID_CHARS,
-            str.data(), static_cast<int>(str.size()),
-            nullptr, 0);
+    size_t format_percent(char* buf, double fraction) {
+        double rounded = std::round(fraction * 100.);
 
-        std::wstring result(size, '\0');
+        char* out;
+        if (std::abs(rounded) < 1e18) {
+            out = append_int(buf, static_cast<int64_t>(rounded));
+        } else {
+            // Infinity, NaN or too large for an integer
+            out = std::to_chars(buf, buf + nao::formatted_size_max - 1, rounded).ptr;
+        }
 
-        int converted = MultiByteToWideChar(
-            CP_UTF8, MB_ERR_INVALID_CHARS,
-            str.data(), static_cast<int>(str.size()),
-            result.data(), size);
+        *out++ = '%';
+        return out - buf;
+    }
+
+    constexpr bool parses_back(std::string_view str, uint64_t nanoseconds, nao::duration_format format) {
+        char buf[nao::formatted_size_max] {};
+        auto [end, ec] = nao::format_duration(buf, buf + sizeof(buf), nanoseconds, format);
+        uint64_t parsed = 0;
+        auto res = nao::parse_duration(buf, end, parsed);
+        return ec == std::errc {} && std::string_view(buf, end - buf) == str && res.ptr == end && parsed == nanoseconds;
+    }
 
-        if (converted != size) {
-            throw std::runtime_error("failed converting narrow string to wide string");
+    static_assert(parses_back("1:02:03.004", 3'723'004'000'000, {}));
+    static_assert(parses_back("2d 00:00:01.000000001", 172'801'000'000'001, { nao::time_unit::days, 9 }));
+
+    std::to_chars_result copy_out(char* first, char* last, std::span<const char> formatted) {
+        if (static_cast<size_t>(last - first) < formatted.size()) {
+            return { last, std::errc::value_too_large };
         }
 
-        return result;
+        std::memcpy(first, formatted.data(), formatted.size());
+        return { first + formatted.size(), std::errc {} };
     }
+}
 
-    std::string to_utf8(std::wstring_view str) {
-        int size = WideCharToMultiByte(
-            CP_UTF8, WC_COMPOSITECHECK | WC_NO_BEST_FIT_CHARS,
-            str.data(), static_cast<int>(str.size()),
-            nullptr, 0, nullptr, nullptr);
+namespace nao {
+    std::to_chars_result to_chars(char* first, char* last, byte_size value) {
+        return to_chars(first, last, unit_value { value.count, iec_bytes });
+    }
 
-        std::string result(size, '\0');
+    std::to_chars_result to_chars(char* first, char* last, bit_size value) {
+        return to_chars(first, last, unit_value { value.count, iec_bits });
+    }
 
-        int converted = WideCharToMultiByte(
-            CP_UTF8, WC_COMPOSITECHECK | WC_NO_BEST_FIT_CHARS,
-            str.data(), static_cast<int>(str.size()),
-            result.data(), size, nullptr, nullptr);
+    std::to_chars_result to_chars(char* first, char* last, unit_value value) {
+        formatted buf;
+        size_t unit;
+        size_t size = format_scaled(buf, value.count, value.format, unit);
+        unit_name name = name_of(value.format, unit);
 
-        if (converted != size) {
-            throw std::runtime_error("failed converting wide string to narrow string");
+        if (static_cast<size_t>(last - first) < size + name.size()) {
+            return { last, std::errc::value_too_large };
         }
 
+        return { name.append_to(append(first, { buf, size })), std::errc {} };
+    }
+
+    std::to_chars_result to_chars(char* first, char* last, percentage value) {
+        formatted buf;
+        return copy_out(first, last, { buf, format_percent(buf, value.fraction) });
+    }
+
+    std::to_chars_result to_chars(char* first, char* last, clock_time value) {
+        return format_duration(first, last, value.nanoseconds, value.format);
+    }
+
+    std::string bytes(size_t n) {
+        return std::string { to_inline_string(byte_size { n }) };
+    }
+
+    std::string bits(size_t n) {
+        return std::string { to_inline_string(bit_size { n }) };
+    }
+
+    std::string format_units(uint64_t n, const unit_format& format) {
+        formatted buf;
+        size_t unit;
+        size_t size = format_scaled(buf, n, format, unit);
+        unit_name name = name_of(format, unit);
+
+        std::string result(size + name.size(), '\0');
+        name.append_to(append(result.data(), { buf, size }));
         return result;
     }
+
+    std::string percent(double v) {
+        return std::string { to_inline_string(percentage { v }) };
+    }
+
+    std::string time_hours(uint64_t nanoseconds, bool add_ms) {
+        return std::string { to_inline_string(clock_time { nanoseconds, { time_unit::hours, add_ms ? uint8_t { 3 } : uint8_t { 0 } } }) };
+    }
+
+    std::string time_minutes(uint64_t nanoseconds, bool add_ms) {
+        return std::string { to_inline_string(clock_time { nanoseconds, { time_unit::minutes, add_ms ? uint8_t { 3 } : uint8_t { 0 } } }) };
+    }
 }
@@ -0,0 +1,1872 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "nao/strings.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define NAO_UTF_X64
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NAO_TARGET_SSSE3
+#define NAO_TARGET_AVX2
+#define NAO_INLINE_SSSE3 __forceinline
+#else
+#define NAO_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define NAO_TARGET_AVX2 __attribute__((target("avx2")))
+
+// Inlined into the AVX2 kernels too, where it is VEX encoded. Calling SSE encoded
+// code with the upper halves of the YMM registers in use stalls on every transition.
+#define NAO_INLINE_SSSE3 __attribute__((target("ssse3"), always_inline)) inline
+#endif
+
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define NAO_UTF_NEON
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/**
+ * UTF-8 <-> UTF-16/UTF-32 and Latin-1 transcoding. Runs of ASCII are handled
+ * 16 or 32 bytes at a time with SSE2, AVX2 or NEON. Between UTF-8 and UTF-16,
+ * sequences of up to 3 bytes are converted with byte shuffles (SSSE3, AVX2 or
+ * NEON), 4 byte sequences, surrogates and invalid input by a strict scalar
+ * decoder. With AVX2, validation checks whole blocks using the lookup tables
+ * from Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte".
+ */
+
+namespace {
+    struct transcode_result {
+        // Input consumed, or the offset of the offending sequence on failure
+        size_t read;
+        size_t written;
+        bool ok;
+    };
+
+    template <typename CharT>
+    constexpr bool simd_unit = sizeof(CharT) == 2;
+
+    ///////////////////////////////////////////////////////////////////////////
+    //  Scalar building blocks
+    ///////////////////////////////////////////////////////////////////////////
+
+    bool is_continuation(uint8_t c) {
+        return (c & 0xC0) == 0x80;
+    }
+
+    /**
+     * @brief Decodes the code point starting at `in[i]`, rejecting everything
+     *          MB_ERR_INVALID_CHARS rejects: overlong forms, surrogates, values
+     *          above U+10FFFF and truncated sequences.
+     * @return The number of bytes consumed, 0 if the sequence is invalid.
+     */
+    size_t decode_utf8(const uint8_t* in, size_t len, size_t i, char32_t& cp) {
+        uint8_t c = in[i];
+        if (c < 0x80) {
+            cp = c;
+            return 1;
+        }
+
+        size_t left = len - i;
+        if (c < 0xC2) {
+            return 0;
+        }
+
+        if (c < 0xE0) {
+            if (left < 2 || !is_continuation(in[i + 1])) {
+                return 0;
+            }
+
+            cp = (char32_t { c & 0x1Fu } << 6) | (in[i + 1] & 0x3F);
+            return 2;
+        }
+
+        if (c < 0xF0) {
+            if (left < 3 || !is_continuation(in[i + 1]) || !is_continuation(in[i + 2])
+                || (c == 0xE0 && in[i + 1] < 0xA0)      // overlong
+                || (c == 0xED && in[i + 1] > 0x9F)) {   // surrogate
+                return 0;
+            }
+
+            cp = (char32_t { c & 0x0Fu } << 12) | (char32_t { in[i + 1] & 0x3Fu } << 6) | (in[i + 2] & 0x3F);
+            return 3;
+        }
+
+        if (c < 0xF5) {
+            if (left < 4 || !is_continuation(in[i + 1]) || !is_continuation(in[i + 2])
+                || !is_continuation(in[i + 3])
+                || (c == 0xF0 && in[i + 1] < 0x90)      // overlong
+                || (c == 0xF4 && in[i + 1] > 0x8F)) {   // above U+10FFFF
+                return 0;
+            }
+
+            cp = (char32_t { c & 0x07u } << 18) | (char32_t { in[i + 1] & 0x3Fu } << 12)
+                | (char32_t { in[i + 2] & 0x3Fu } << 6) | (in[i + 3] & 0x3F);
+            return 4;
+        }
+
+        return 0;
+    }
+
+    template <typename CharT>
+    constexpr bool is_utf32 = std::is_same_v<CharT, char32_t>;
+
+    /**
+     * @brief Writes `cp` as UTF-16, or as a single unit for char32_t.
+     */
+    template <typename CharT>
+    size_t put_utf16(char32_t cp, CharT* out) {
+        if (is_utf32<CharT> || cp < 0x10000) {
+            out[0] = static_cast<CharT>(cp);
+            return 1;
+        }
+
+        cp -= 0x10000;
+        out[0] = static_cast<CharT>(0xD800 + (cp >> 10));
+        out[1] = static_cast<CharT>(0xDC00 + (cp & 0x3FF));
+        return 2;
+    }
+
+    size_t put_utf8(char32_t cp, char* out) {
+        if (cp < 0x80) {
+            out[0] = static_cast<char>(cp);
+            return 1;
+        }
+
+        if (cp < 0x800) {
+            out[0] = static_cast<char>(0xC0 | (cp >> 6));
+            out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 2;
+        }
+
+        if (cp < 0x10000) {
+            out[0] = static_cast<char>(0xE0 | (cp >> 12));
+            out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 3;
+        }
+
+        out[0] = static_cast<char>(0xF0 | (cp >> 18));
+        out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 4;
+    }
+
+    /**
+     * @brief Reads the code point starting at `in[i]`. Unpaired surrogates become
+     *          U+FFFD, like WideCharToMultiByte does without WC_ERR_INVALID_CHARS.
+     *          Units above 0xFFFF (only possible with a 32-bit wchar_t) are taken
+     *          to be UTF-32. For char32_t every unit is a code point of its own.
+     * @return The number of units consumed.
+     */
+    template <typename CharT>
+    size_t decode_utf16(const CharT* in, size_t len, size_t i, char32_t& cp) {
+        auto c = static_cast<char32_t>(in[i]);
+        if (c < 0xD800 || (c > 0xDFFF && c <= 0x10FFFF)) {
+            cp = c;
+            return 1;
+        }
+
+        if constexpr (is_utf32<CharT>) {
+            cp = 0xFFFD;
+            return 1;
+        }
+
+        if (c <= 0xDBFF && i + 1 < len) {
+            auto next = static_cast<char32_t>(in[i + 1]);
+            if (next >= 0xDC00 && next <= 0xDFFF) {
+                cp = 0x10000 + ((c - 0xD800) << 10) + (next - 0xDC00);
+                return 2;
+            }
+        }
+
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    bool ascii8(const uint8_t* in) {
+        uint64_t v;
+        std::memcpy(&v, in, sizeof(v));
+        return (v & 0x8080808080808080) == 0;
+    }
+
+    /**
+     * @brief Converts until at least `in + end` has been reached, or the input ends.
+     */
+    template <typename CharT>
+    bool utf8_to_utf16_until(const uint8_t* in, size_t len, size_t end, size_t& i, CharT* out, size_t& o) {
+        while (i < end) {
+            uint8_t c = in[i];
+            if (c < 0x80) {
+                if (i + 8 <= len && ascii8(in + i)) {
+                    for (size_t k = 0; k < 8; ++k) {
+                        out[o + k] = static_cast<CharT>(in[i + k]);
+                    }
+
+                    i += 8;
+                    o += 8;
+                } else {
+                    out[o++] = static_cast<CharT>(c);
+                    ++i;
+                }
+
+                continue;
+            }
+
+            // Most common case in non-ASCII text, everything else goes the long way
+            if (c >= 0xC2 && c < 0xE0 && i + 1 < len && is_continuation(in[i + 1])) {
+                out[o++] = static_cast<CharT>(((c & 0x1Fu) << 6) | (in[i + 1] & 0x3Fu));
+                i += 2;
+                continue;
+            }
+
+            char32_t cp;
+            size_t size = decode_utf8(in, len, i, cp);
+            if (size == 0) {
+                return false;
+            }
+
+            i += size;
+            o += put_utf16(cp, out + o);
+        }
+
+        return true;
+    }
+
+    template <typename CharT>
+    void utf16_to_utf8_until(const CharT* in, size_t len, size_t end, size_t& i, char* out, size_t& o) {
+        while (i < end) {
+            auto c = static_cast<char32_t>(in[i]);
+            if (c < 0x80) {
+                out[o++] = static_cast<char>(c);
+                ++i;
+            } else if (c < 0x800) {
+                out[o] = static_cast<char>(0xC0 | (c >> 6));
+                out[o + 1] = static_cast<char>(0x80 | (c & 0x3F));
+                o += 2;
+                ++i;
+            } else {
+                char32_t cp;
+                i += decode_utf16(in, len, i, cp);
+                o += put_utf8(cp, out + o);
+            }
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    //  Kernels, each processing a whole buffer
+    ///////////////////////////////////////////////////////////////////////////
+
+    template <typename CharT>
+    transcode_result utf8_to_utf16_scalar(const char* str, size_t len, CharT* out) {
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        size_t i = 0, o = 0;
+        bool ok = utf8_to_utf16_until(in, len, len, i, out, o);
+        return { i, o, ok };
+    }
+
+    template <typename CharT>
+    transcode_result utf16_to_utf8_scalar(const CharT* in, size_t len, char* out) {
+        size_t i = 0, o = 0;
+        utf16_to_utf8_until(in, len, len, i, out, o);
+        return { i, o, true };
+    }
+
+#if defined(NAO_UTF_X64) || defined(NAO_UTF_NEON)
+    ///////////////////////////////////////////////////////////////////////////
+    //  Shuffle tables for multi-byte sequences, shared by SSSE3, AVX2 and NEON
+    ///////////////////////////////////////////////////////////////////////////
+
+    // Byte indices for pshufb/tbl, an index with the top bit set yields 0
+    struct alignas(16) byte_shuffle {
+        uint8_t index[16];
+    };
+
+    constexpr uint8_t no_byte = 0x80;
+
+    // How to convert the sequences in a window of UTF-8, see utf_tables::windows
+    struct utf8_window {
+        uint16_t shuffle;
+        uint8_t read;
+        uint8_t count;
+    };
+
+    // How to pack the bytes of encoded UTF-16 units together
+    struct utf8_packing {
+        byte_shuffle shuffle;
+        uint8_t size;
+    };
+
+    struct utf_tables {
+        /*
+         * Indexed by which of the first 12 bytes of a window end a sequence, that is,
+         * are followed by a byte that is no continuation. Tells how many of the
+         * sequences at the start of the window are at most 3 bytes long (up to 8)
+         * and the shuffle moving the last two bytes of each into a 16-bit lane.
+         */
+        std::array<utf8_window, 4096> windows {};
+        std::vector<byte_shuffle> shuffles;
+
+        // Indexed by which of 8 units (16-bit lanes of lead and continuation) take 2 bytes
+        std::array<utf8_packing, 256> pack_2 {};
+
+        // Indexed by the size minus 1 of 4 units (32-bit lanes of up to 3 bytes), 2 bits each
+        std::array<utf8_packing, 256> pack_3 {};
+
+        utf_tables() {
+            std::map<std::array<uint8_t, 16>, uint16_t> unique;
+
+            for (size_t ends = 0; ends < windows.size(); ++ends) {
+                std::array<uint8_t, 16> index;
+                index.fill(no_byte);
+
+                size_t pos = 0, count = 0;
+                while (count < 8) {
+                    size_t end = pos;
+                    while (end < 12 && !(ends & (size_t { 1 } << end))) {
+                        ++end;
+                    }
+
+                    if (end == 12 || end - pos > 2) {
+                        break;
+                    }
+
+                    index[2 * count] = static_cast<uint8_t>(end);
+                    index[2 * count + 1] = end > pos ? static_cast<uint8_t>(end - 1) : no_byte;
+                    pos = end + 1;
+                    ++count;
+                }
+
+                auto [it, inserted] = unique.try_emplace(index, static_cast<uint16_t>(shuffles.size()));
+                if (inserted) {
+                    byte_shuffle& shuffle = shuffles.emplace_back();
+                    std::memcpy(shuffle.index, index.data(), index.size());
+                }
+
+                windows[ends] = { it->second, static_cast<uint8_t>(pos), static_cast<uint8_t>(count) };
+            }
+
+            for (size_t mask = 0; mask < 256; ++mask) {
+                utf8_packing& two = pack_2[mask];
+                std::memset(two.shuffle.index, no_byte, sizeof(two.shuffle.index));
+                for (size_t unit = 0; unit < 8; ++unit) {
+                    two.shuffle.index[two.size++] = static_cast<uint8_t>(2 * unit);
+                    if (mask & (size_t { 1 } << unit)) {
+                        two.shuffle.index[two.size++] = static_cast<uint8_t>(2 * unit + 1);
+                    }
+                }
+
+                utf8_packing& three = pack_3[mask];
+                std::memset(three.shuffle.index, no_byte, sizeof(three.shuffle.index));
+                for (size_t unit = 0; unit < 4; ++unit) {
+                    size_t size = std::min<size_t>(((mask >> (2 * unit)) & 3) + 1, 3);
+                    for (size_t byte = 0; byte < size; ++byte) {
+                        three.shuffle.index[three.size++] = static_cast<uint8_t>(4 * unit + byte);
+                    }
+                }
+            }
+        }
+
+        static const utf_tables& get() {
+            static const utf_tables instance;
+            return instance;
+        }
+    };
+#endif
+
+#if defined(NAO_UTF_X64)
+    template <typename CharT>
+    transcode_result utf8_to_utf16_sse2(const char* str, size_t len, CharT* out) {
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        size_t i = 0, o = 0;
+        const __m128i zero = _mm_setzero_si128();
+
+        while (i + 16 <= len) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            if (_mm_movemask_epi8(v) == 0) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_unpacklo_epi8(v, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o + 8), _mm_unpackhi_epi8(v, zero));
+                i += 16;
+                o += 16;
+            } else if (!utf8_to_utf16_until(in, len, i + 16, i, out, o)) {
+                return { i, o, false };
+            }
+        }
+
+        bool ok = utf8_to_utf16_until(in, len, len, i, out, o);
+        return { i, o, ok };
+    }
+
+    /**
+     * @brief Converts the sequences described by `window` from the start of `v`.
+     *          Stores 8 units, of which `window.count` are valid.
+     * @return False if a sequence is invalid, nothing was stored then.
+     */
+    template <typename CharT>
+    NAO_INLINE_SSSE3 bool utf8_window_ssse3(const utf_tables& tables, const utf8_window& window, __m128i v, CharT* out) {
+        const __m128i zero = _mm_setzero_si128();
+
+        // Last byte of each sequence in the low half of its lane, the one before it in the high half
+        __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.shuffles[window.shuffle].index));
+        __m128i pairs = _mm_shuffle_epi8(v, shuffle);
+
+        __m128i second = _mm_srli_epi16(pairs, 8);
+        __m128i three = _mm_cmpeq_epi16(_mm_and_si128(second, _mm_set1_epi16(0xC0)), _mm_set1_epi16(0x80));
+
+        // Only the first byte of a sequence can be wrong, the others are continuations by construction
+        __m128i valid_1 = _mm_cmpeq_epi16(_mm_and_si128(pairs, _mm_set1_epi16(static_cast<short>(0xFF80))), zero);
+        __m128i valid_2 = _mm_and_si128(_mm_cmpgt_epi16(second, _mm_set1_epi16(0xC1)),
+            _mm_cmplt_epi16(second, _mm_set1_epi16(0xE0)));
+
+        __m128i cp, valid;
+        if (_mm_movemask_epi8(three) == 0) {
+            // Continuation bytes lose their top bits to the mask, as do the valid lead bytes
+            cp = _mm_or_si128(_mm_and_si128(pairs, _mm_set1_epi16(0x7F)),
+                _mm_slli_epi16(_mm_and_si128(second, _mm_set1_epi16(0x1F)), 6));
+            valid = _mm_or_si128(valid_1, valid_2);
+        } else {
+            // The byte before those in the low half, the high half's index gets the top bit set
+            __m128i lead_index = _mm_or_si128(_mm_sub_epi16(_mm_srli_epi16(shuffle, 8), _mm_set1_epi16(1)),
+                _mm_set1_epi16(static_cast<short>(0x8000)));
+            __m128i first = _mm_and_si128(_mm_shuffle_epi8(v, lead_index), three);
+
+            cp = _mm_or_si128(_mm_and_si128(pairs, _mm_set1_epi16(0x7F)),
+                _mm_or_si128(_mm_slli_epi16(_mm_and_si128(second, _mm_set1_epi16(0x3F)), 6),
+                    _mm_slli_epi16(_mm_and_si128(first, _mm_set1_epi16(0x0F)), 12)));
+
+            __m128i top = _mm_and_si128(cp, _mm_set1_epi16(static_cast<short>(0xF800)));
+            __m128i invalid_3 = _mm_or_si128(_mm_cmpeq_epi16(top, zero),
+                _mm_cmpeq_epi16(top, _mm_set1_epi16(static_cast<short>(0xD800))));
+            __m128i valid_3 = _mm_andnot_si128(invalid_3, _mm_and_si128(three,
+                _mm_cmpeq_epi16(_mm_and_si128(first, _mm_set1_epi16(0xF0)), _mm_set1_epi16(0xE0))));
+
+            valid = _mm_or_si128(_mm_or_si128(valid_1, valid_2), valid_3);
+        }
+
+        if (_mm_movemask_epi8(valid) != 0xFFFF) {
+            return false;
+        }
+
+        if constexpr (sizeof(CharT) == 2) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), cp);
+        } else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(cp, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(cp, zero));
+        }
+
+        return true;
+    }
+
+    // Bit k set if byte k is no continuation byte
+    NAO_INLINE_SSSE3 unsigned utf8_starts_ssse3(__m128i v) {
+        // Continuation bytes are the ones from -128 to -65
+        return static_cast<unsigned>(~_mm_movemask_epi8(_mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(0xC0))))) & 0xFFFF;
+    }
+
+    /**
+     * @brief Converts the next 16 bytes if they are ASCII, else the sequences of up to
+     *          3 bytes that end within the next 12. Needs 16 readable bytes at `in + i`.
+     * @return False if the input is invalid, `i` is then the offset of the offending sequence.
+     */
+    template <typename CharT>
+    NAO_INLINE_SSSE3 bool utf8_to_utf16_step_ssse3(const utf_tables& tables,
+        const uint8_t* in, size_t len, size_t& i, CharT* out, size_t& o) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+
+        if (_mm_movemask_epi8(v) == 0) {
+            const __m128i zero = _mm_setzero_si128();
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o + 8), _mm_unpackhi_epi8(v, zero));
+            i += 16;
+            o += 16;
+            return true;
+        }
+
+        const utf8_window& window = tables.windows[(utf8_starts_ssse3(v) >> 1) & 0xFFF];
+
+        // A 4 byte sequence comes first, or a run of continuations
+        if (window.count == 0) {
+            return utf8_to_utf16_until(in, len, i + 1, i, out, o);
+        }
+
+        if (!utf8_window_ssse3(tables, window, v, out + o)) {
+            // Let the scalar decoder find the exact offset
+            return utf8_to_utf16_until(in, len, i + window.read, i, out, o);
+        }
+
+        i += window.read;
+        o += window.count;
+        return true;
+    }
+
+    /**
+     * @brief Converts at least the sequences ending in the next 52 bytes.
+     *          Needs 80 readable bytes at `in + i`.
+     *
+     * Finds where all sequences of a 64 byte block end up front, so that finding the next
+     * window only waits on the previous one's table entry instead of on a load and a movemask.
+     *
+     * @return False if the input is invalid, `i` is then the offset of the offending sequence.
+     */
+    template <typename CharT>
+    NAO_INLINE_SSSE3 bool utf8_to_utf16_block_ssse3(const utf_tables& tables,
+        const uint8_t* in, size_t len, size_t& i, CharT* out, size_t& o) {
+        const __m128i zero = _mm_setzero_si128();
+
+        uint64_t starts = 0;
+        for (size_t k = 0; k < 64; k += 16) {
+            starts |= uint64_t { utf8_starts_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + k))) } << k;
+        }
+
+        // Bit k set if byte k ends a sequence
+        uint64_t ends = (starts >> 1) | (uint64_t { !is_continuation(in[i + 64]) } << 63);
+
+        size_t pos = 0;
+        while (pos <= 52) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + pos));
+            if (_mm_movemask_epi8(v) == 0) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_unpacklo_epi8(v, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o + 8), _mm_unpackhi_epi8(v, zero));
+                pos += 16;
+                o += 16;
+                continue;
+            }
+
+            const utf8_window& window = tables.windows[(ends >> pos) & 0xFFF];
+            if (window.count == 0 || !utf8_window_ssse3(tables, window, v, out + o)) {
+                i += pos;
+                return utf8_to_utf16_until(in, len, i + std::max<size_t>(window.read, 1), i, out, o);
+            }
+
+            pos += window.read;
+            o += window.count;
+        }
+
+        i += pos;
+        return true;
+    }
+
+    template <typename CharT>
+    NAO_TARGET_SSSE3 transcode_result utf8_to_utf16_ssse3(const char* str, size_t len, CharT* out) {
+        const utf_tables& tables = utf_tables::get();
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        size_t i = 0, o = 0;
+
+        const __m128i zero = _mm_setzero_si128();
+
+        while (i + 80 <= len) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            if (_mm_movemask_epi8(v) == 0) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_unpacklo_epi8(v, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o + 8), _mm_unpackhi_epi8(v, zero));
+                i += 16;
+                o += 16;
+            } else if (!utf8_to_utf16_block_ssse3(tables, in, len, i, out, o)) {
+                return { i, o, false };
+            }
+        }
+
+        while (i + 16 <= len) {
+            if (!utf8_to_utf16_step_ssse3(tables, in, len, i, out, o)) {
+                return { i, o, false };
+            }
+        }
+
+        bool ok = utf8_to_utf16_until(in, len, len, i, out, o);
+        return { i, o, ok };
+    }
+
+    template <typename CharT>
+    NAO_TARGET_AVX2 transcode_result utf8_to_utf16_avx2(const char* str, size_t len, CharT* out) {
+        const utf_tables& tables = utf_tables::get();
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        size_t i = 0, o = 0;
+
+        while (i + 80 <= len) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            if (_mm256_movemask_epi8(v) == 0) {
+                __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+                __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o), lo);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o + 16), hi);
+                i += 32;
+                o += 32;
+            } else {
+                // The scalar fallbacks are SSE encoded, mixing them with dirty upper halves stalls
+                _mm256_zeroupper();
+                if (!utf8_to_utf16_block_ssse3(tables, in, len, i, out, o)) {
+                    return { i, o, false };
+                }
+            }
+        }
+
+        while (i + 16 <= len) {
+            if (!utf8_to_utf16_step_ssse3(tables, in, len, i, out, o)) {
+                return { i, o, false };
+            }
+        }
+
+        bool ok = utf8_to_utf16_until(in, len, len, i, out, o);
+        return { i, o, ok };
+    }
+
+    template <typename CharT>
+    transcode_result utf16_to_utf8_sse2(const CharT* in, size_t len, char* out) {
+        size_t i = 0, o = 0;
+        const __m128i high = _mm_set1_epi16(static_cast<short>(0xFF80));
+
+        while (i + 8 <= len) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, high), _mm_setzero_si128())) == 0xFFFF) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + o), _mm_packus_epi16(v, v));
+                i += 8;
+                o += 8;
+            } else {
+                utf16_to_utf8_until(in, len, i + 8, i, out, o);
+            }
+        }
+
+        utf16_to_utf8_until(in, len, len, i, out, o);
+        return { i, o, true };
+    }
+
+    /**
+     * @brief Converts the next 8 units, unless they include surrogates.
+     *          Needs 16 readable units at `in + i`, so that every store fits the output.
+     */
+    template <typename CharT>
+    NAO_INLINE_SSSE3 void utf16_to_utf8_step_ssse3(const utf_tables& tables,
+        const CharT* in, size_t len, size_t& i, char* out, size_t& o) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+
+        __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xFF80))), zero);
+        __m128i small = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xF800))), zero);
+
+        if (_mm_movemask_epi8(ascii) == 0xFFFF) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + o), _mm_packus_epi16(v, v));
+            i += 8;
+            o += 8;
+            return;
+        }
+
+        __m128i cont = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi16(0x3F)), _mm_set1_epi16(0x80));
+        __m128i lead_2 = _mm_or_si128(_mm_srli_epi16(v, 6), _mm_set1_epi16(0xC0));
+
+        if (_mm_movemask_epi8(small) == 0xFFFF) {
+            // Lead or ASCII byte in the low half of each lane, continuation in the high half
+            __m128i first = _mm_or_si128(_mm_and_si128(ascii, v), _mm_andnot_si128(ascii, lead_2));
+            __m128i bytes = _mm_or_si128(first, _mm_slli_epi16(cont, 8));
+
+            auto two = static_cast<unsigned>(~_mm_movemask_epi8(_mm_packs_epi16(ascii, ascii)) & 0xFF);
+            const utf8_packing& packing = tables.pack_2[two];
+            __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(packing.shuffle.index));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_shuffle_epi8(bytes, shuffle));
+
+            i += 8;
+            o += packing.size;
+            return;
+        }
+
+        __m128i surrogate = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xF800))),
+            _mm_set1_epi16(static_cast<short>(0xD800)));
+        if (_mm_movemask_epi8(surrogate) != 0) {
+            utf16_to_utf8_until(in, len, i + 8, i, out, o);
+            return;
+        }
+
+        __m128i two = _mm_andnot_si128(ascii, small);
+        __m128i mid = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 6), _mm_set1_epi16(0x3F)), _mm_set1_epi16(0x80));
+        __m128i lead_3 = _mm_or_si128(_mm_srli_epi16(v, 12), _mm_set1_epi16(0xE0));
+
+        // First two bytes of each unit in one 16-bit lane, the third in another
+        __m128i first = _mm_or_si128(_mm_or_si128(_mm_and_si128(ascii, v), _mm_and_si128(two, lead_2)),
+            _mm_andnot_si128(small, lead_3));
+        __m128i second = _mm_or_si128(_mm_and_si128(two, cont), _mm_andnot_si128(small, mid));
+        __m128i third = _mm_andnot_si128(small, cont);
+
+        __m128i lo_bytes = _mm_or_si128(first, _mm_slli_epi16(second, 8));
+        __m128i lo = _mm_unpacklo_epi16(lo_bytes, third);
+        __m128i hi = _mm_unpackhi_epi16(lo_bytes, third);
+
+        // 2 bits per unit holding its size minus 1
+        auto sizes = static_cast<unsigned>((~_mm_movemask_epi8(ascii) & 0x5555) + (~_mm_movemask_epi8(small) & 0x5555));
+
+        const utf8_packing& lo_packing = tables.pack_3[sizes & 0xFF];
+        __m128i lo_shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(lo_packing.shuffle.index));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_shuffle_epi8(lo, lo_shuffle));
+        o += lo_packing.size;
+
+        const utf8_packing& hi_packing = tables.pack_3[sizes >> 8];
+        __m128i hi_shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(hi_packing.shuffle.index));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_shuffle_epi8(hi, hi_shuffle));
+        o += hi_packing.size;
+
+        i += 8;
+    }
+
+    template <typename CharT>
+    NAO_TARGET_SSSE3 transcode_result utf16_to_utf8_ssse3(const CharT* in, size_t len, char* out) {
+        const utf_tables& tables = utf_tables::get();
+        size_t i = 0, o = 0;
+
+        while (i + 16 <= len) {
+            utf16_to_utf8_step_ssse3(tables, in, len, i, out, o);
+        }
+
+        utf16_to_utf8_until(in, len, len, i, out, o);
+        return { i, o, true };
+    }
+
+    template <typename CharT>
+    NAO_TARGET_AVX2 transcode_result utf16_to_utf8_avx2(const CharT* in, size_t len, char* out) {
+        const utf_tables& tables = utf_tables::get();
+        size_t i = 0, o = 0;
+        const __m256i high = _mm256_set1_epi16(static_cast<short>(0xFF80));
+
+        while (i + 16 <= len) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            if (_mm256_testz_si256(v, high)) {
+                // packus works per 128-bit lane, so pack the two halves explicitly
+                __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), packed);
+                i += 16;
+                o += 16;
+            } else {
+                _mm256_zeroupper();
+
+                // Text that is not ASCII here likely is not in the next units either
+                utf16_to_utf8_step_ssse3(tables, in, len, i, out, o);
+                if (i + 16 <= len) {
+                    utf16_to_utf8_step_ssse3(tables, in, len, i, out, o);
+                }
+            }
+        }
+
+        utf16_to_utf8_until(in, len, len, i, out, o);
+        return { i, o, true };
+    }
+
+    bool has_avx2() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+
+        // OS has to save the YMM registers
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+            return false;
+        }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    bool has_ssse3() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#else
+        return __builtin_cpu_supports("ssse3");
+#endif
+    }
+#elif defined(NAO_UTF_NEON)
+    // Bit k set if byte k is no continuation byte
+    unsigned utf8_starts_neon(uint8x16_t v) {
+        static constexpr uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        uint8x16_t cont = vceqq_u8(vandq_u8(v, vdupq_n_u8(0xC0)), vdupq_n_u8(0x80));
+        uint8x16_t starts = vbicq_u8(vld1q_u8(bits), cont);
+        return vaddv_u8(vget_low_u8(starts)) | (unsigned { vaddv_u8(vget_high_u8(starts)) } << 8);
+    }
+
+    /**
+     * @brief Converts the sequences described by `window` from the start of `v`,
+     *          like utf8_window_ssse3. Stores 8 units, of which `window.count` are valid.
+     * @return False if a sequence is invalid, nothing was stored then.
+     */
+    template <typename CharT>
+    bool utf8_window_neon(const utf_tables& tables, const utf8_window& window, uint8x16_t v, CharT* out) {
+        // Indices from 16 up yield 0 for tbl too, so the shuffles are the same as for pshufb
+        uint8x16_t shuffle = vld1q_u8(tables.shuffles[window.shuffle].index);
+        uint16x8_t pairs = vreinterpretq_u16_u8(vqtbl1q_u8(v, shuffle));
+
+        uint16x8_t second = vshrq_n_u16(pairs, 8);
+        uint16x8_t three = vceqq_u16(vandq_u16(second, vdupq_n_u16(0xC0)), vdupq_n_u16(0x80));
+
+        uint16x8_t valid_1 = vceqq_u16(vandq_u16(pairs, vdupq_n_u16(0xFF80)), vdupq_n_u16(0));
+        uint16x8_t valid_2 = vandq_u16(vcgtq_u16(second, vdupq_n_u16(0xC1)), vcltq_u16(second, vdupq_n_u16(0xE0)));
+
+        uint16x8_t cp, valid;
+        if (vmaxvq_u16(three) == 0) {
+            cp = vorrq_u16(vandq_u16(pairs, vdupq_n_u16(0x7F)), vshlq_n_u16(vandq_u16(second, vdupq_n_u16(0x1F)), 6));
+            valid = vorrq_u16(valid_1, valid_2);
+        } else {
+            uint16x8_t lead_index = vorrq_u16(vsubq_u16(vshrq_n_u16(vreinterpretq_u16_u8(shuffle), 8), vdupq_n_u16(1)),
+                vdupq_n_u16(0x8000));
+            uint16x8_t first = vandq_u16(vreinterpretq_u16_u8(vqtbl1q_u8(v, vreinterpretq_u8_u16(lead_index))), three);
+
+            cp = vorrq_u16(vandq_u16(pairs, vdupq_n_u16(0x7F)),
+                vorrq_u16(vshlq_n_u16(vandq_u16(second, vdupq_n_u16(0x3F)), 6),
+                    vshlq_n_u16(vandq_u16(first, vdupq_n_u16(0x0F)), 12)));
+
+            uint16x8_t top = vandq_u16(cp, vdupq_n_u16(0xF800));
+            uint16x8_t invalid_3 = vorrq_u16(vceqq_u16(top, vdupq_n_u16(0)), vceqq_u16(top, vdupq_n_u16(0xD800)));
+            uint16x8_t valid_3 = vbicq_u16(vandq_u16(three,
+                vceqq_u16(vandq_u16(first, vdupq_n_u16(0xF0)), vdupq_n_u16(0xE0))), invalid_3);
+
+            valid = vorrq_u16(vorrq_u16(valid_1, valid_2), valid_3);
+        }
+
+        if (vminvq_u16(valid) != 0xFFFF) {
+            return false;
+        }
+
+        vst1q_u16(reinterpret_cast<uint16_t*>(out), cp);
+        return true;
+    }
+
+    /**
+     * @brief Converts the next 16 bytes if they are ASCII, else the sequences of up to
+     *          3 bytes that end within the next 12. Needs 16 readable bytes at `in + i`.
+     * @return False if the input is invalid, `i` is then the offset of the offending sequence.
+     */
+    template <typename CharT>
+    bool utf8_to_utf16_step_neon(const utf_tables& tables,
+        const uint8_t* in, size_t len, size_t& i, CharT* out, size_t& o) {
+        uint8x16_t v = vld1q_u8(in + i);
+
+        if (vmaxvq_u8(v) < 0x80) {
+            vst1q_u16(reinterpret_cast<uint16_t*>(out + o), vmovl_u8(vget_low_u8(v)));
+            vst1q_u16(reinterpret_cast<uint16_t*>(out + o + 8), vmovl_high_u8(v));
+            i += 16;
+            o += 16;
+            return true;
+        }
+
+        const utf8_window& window = tables.windows[(utf8_starts_neon(v) >> 1) & 0xFFF];
+        if (window.count == 0) {
+            return utf8_to_utf16_until(in, len, i + 1, i, out, o);
+        }
+
+        if (!utf8_window_neon(tables, window, v, out + o)) {
+            return utf8_to_utf16_until(in, len, i + window.read, i, out, o);
+        }
+
+        i += window.read;
+        o += window.count;
+        return true;
+    }
+
+    /**
+     * @brief Converts at least the sequences ending in the next 52 bytes, like
+     *          utf8_to_utf16_block_ssse3. Needs 80 readable bytes at `in + i`.
+     * @return False if the input is invalid, `i` is then the offset of the offending sequence.
+     */
+    template <typename CharT>
+    bool utf8_to_utf16_block_neon(const utf_tables& tables,
+        const uint8_t* in, size_t len, size_t& i, CharT* out, size_t& o) {
+        uint64_t starts = 0;
+        for (size_t k = 0; k < 64; k += 16) {
+            starts |= uint64_t { utf8_starts_neon(vld1q_u8(in + i + k)) } << k;
+        }
+
+        uint64_t ends = (starts >> 1) | (uint64_t { !is_continuation(in[i + 64]) } << 63);
+
+        size_t pos = 0;
+        while (pos <= 52) {
+            uint8x16_t v = vld1q_u8(in + i + pos);
+            if (vmaxvq_u8(v) < 0x80) {
+                vst1q_u16(reinterpret_cast<uint16_t*>(out + o), vmovl_u8(vget_low_u8(v)));
+                vst1q_u16(reinterpret_cast<uint16_t*>(out + o + 8), vmovl_high_u8(v));
+                pos += 16;
+                o += 16;
+                continue;
+            }
+
+            const utf8_window& window = tables.windows[(ends >> pos) & 0xFFF];
+            if (window.count == 0 || !utf8_window_neon(tables, window, v, out + o)) {
+                i += pos;
+                return utf8_to_utf16_until(in, len, i + std::max<size_t>(window.read, 1), i, out, o);
+            }
+
+            pos += window.read;
+            o += window.count;
+        }
+
+        i += pos;
+        return true;
+    }
+
+    template <typename CharT>
+    transcode_result utf8_to_utf16_neon(const char* str, size_t len, CharT* out) {
+        const utf_tables& tables = utf_tables::get();
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        size_t i = 0, o = 0;
+
+        while (i + 80 <= len) {
+            uint8x16_t v = vld1q_u8(in + i);
+            if (vmaxvq_u8(v) < 0x80) {
+                vst1q_u16(reinterpret_cast<uint16_t*>(out + o), vmovl_u8(vget_low_u8(v)));
+                vst1q_u16(reinterpret_cast<uint16_t*>(out + o + 8), vmovl_high_u8(v));
+                i += 16;
+                o += 16;
+            } else if (!utf8_to_utf16_block_neon(tables, in, len, i, out, o)) {
+                return { i, o, false };
+            }
+        }
+
+        while (i + 16 <= len) {
+            if (!utf8_to_utf16_step_neon(tables, in, len, i, out, o)) {
+                return { i, o, false };
+            }
+        }
+
+        bool ok = utf8_to_utf16_until(in, len, len, i, out, o);
+        return { i, o, ok };
+    }
+
+    /**
+     * @brief Converts the next 8 units like utf16_to_utf8_step_ssse3.
+     *          Needs 16 readable units at `in + i`, so that every store fits the output.
+     */
+    template <typename CharT>
+    void utf16_to_utf8_step_neon(const utf_tables& tables,
+        const CharT* in, size_t len, size_t& i, char* out, size_t& o) {
+        uint16x8_t v = vld1q_u16(reinterpret_cast<const uint16_t*>(in + i));
+        auto dst = reinterpret_cast<uint8_t*>(out);
+
+        uint16_t max = vmaxvq_u16(v);
+        if (max < 0x80) {
+            vst1_u8(dst + o, vmovn_u16(v));
+            i += 8;
+            o += 8;
+            return;
+        }
+
+        uint16x8_t ascii = vcltq_u16(v, vdupq_n_u16(0x80));
+        uint16x8_t cont = vorrq_u16(vandq_u16(v, vdupq_n_u16(0x3F)), vdupq_n_u16(0x80));
+        uint16x8_t lead_2 = vorrq_u16(vshrq_n_u16(v, 6), vdupq_n_u16(0xC0));
+
+        if (max < 0x800) {
+            static constexpr uint8_t bits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+            uint16x8_t bytes = vorrq_u16(vbslq_u16(ascii, v, lead_2), vshlq_n_u16(cont, 8));
+
+            unsigned two = vaddv_u8(vbic_u8(vld1_u8(bits), vmovn_u16(ascii)));
+            const utf8_packing& packing = tables.pack_2[two];
+            vst1q_u8(dst + o, vqtbl1q_u8(vreinterpretq_u8_u16(bytes), vld1q_u8(packing.shuffle.index)));
+
+            i += 8;
+            o += packing.size;
+            return;
+        }
+
+        uint16x8_t surrogate = vceqq_u16(vandq_u16(v, vdupq_n_u16(0xF800)), vdupq_n_u16(0xD800));
+        if (vmaxvq_u16(surrogate) != 0) {
+            utf16_to_utf8_until(in, len, i + 8, i, out, o);
+            return;
+        }
+
+        uint16x8_t small = vcltq_u16(v, vdupq_n_u16(0x800));
+        uint16x8_t mid = vorrq_u16(vandq_u16(vshrq_n_u16(v, 6), vdupq_n_u16(0x3F)), vdupq_n_u16(0x80));
+        uint16x8_t lead_3 = vorrq_u16(vshrq_n_u16(v, 12), vdupq_n_u16(0xE0));
+
+        uint16x8_t first = vbslq_u16(ascii, v, vbslq_u16(small, lead_2, lead_3));
+        uint16x8_t second = vbslq_u16(small, vbicq_u16(cont, ascii), mid);
+        uint16x8_t third = vbicq_u16(cont, small);
+
+        uint16x8_t lo_bytes = vorrq_u16(first, vshlq_n_u16(second, 8));
+        uint16x8_t lo = vzip1q_u16(lo_bytes, third);
+        uint16x8_t hi = vzip2q_u16(lo_bytes, third);
+
+        // 2 bits per unit holding its size minus 1
+        static constexpr int16_t shifts[8] = { 0, 2, 4, 6, 0, 2, 4, 6 };
+        uint16x8_t size = vaddq_u16(vshrq_n_u16(vmvnq_u16(ascii), 15), vshrq_n_u16(vmvnq_u16(small), 15));
+        uint16x8_t sizes = vshlq_u16(size, vld1q_s16(shifts));
+
+        const utf8_packing& lo_packing = tables.pack_3[vaddv_u16(vget_low_u16(sizes))];
+        vst1q_u8(dst + o, vqtbl1q_u8(vreinterpretq_u8_u16(lo), vld1q_u8(lo_packing.shuffle.index)));
+        o += lo_packing.size;
+
+        const utf8_packing& hi_packing = tables.pack_3[vaddv_u16(vget_high_u16(sizes))];
+        vst1q_u8(dst + o, vqtbl1q_u8(vreinterpretq_u8_u16(hi), vld1q_u8(hi_packing.shuffle.index)));
+        o += hi_packing.size;
+
+        i += 8;
+    }
+
+    template <typename CharT>
+    transcode_result utf16_to_utf8_neon(const CharT* in, size_t len, char* out) {
+        const utf_tables& tables = utf_tables::get();
+        size_t i = 0, o = 0;
+
+        while (i + 16 <= len) {
+            utf16_to_utf8_step_neon(tables, in, len, i, out, o);
+        }
+
+        utf16_to_utf8_until(in, len, len, i, out, o);
+        return { i, o, true };
+    }
+#endif
+
+    ///////////////////////////////////////////////////////////////////////////
+    //  UTF-32 kernels, only the ASCII runs differ from the UTF-16 ones
+    ///////////////////////////////////////////////////////////////////////////
+
+#if defined(NAO_UTF_X64)
+    transcode_result utf8_to_utf32_sse2(const char* str, size_t len, char32_t* out) {
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        size_t i = 0, o = 0;
+        const __m128i zero = _mm_setzero_si128();
+
+        while (i + 16 <= len) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            if (_mm_movemask_epi8(v) == 0) {
+                __m128i lo = _mm_unpacklo_epi8(v, zero);
+                __m128i hi = _mm_unpackhi_epi8(v, zero);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_unpacklo_epi16(lo, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o + 4), _mm_unpackhi_epi16(lo, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o + 8), _mm_unpacklo_epi16(hi, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o + 12), _mm_unpackhi_epi16(hi, zero));
+                i += 16;
+                o += 16;
+            } else if (!utf8_to_utf16_until(in, len, i + 16, i, out, o)) {
+                return { i, o, false };
+            }
+        }
+
+        bool ok = utf8_to_utf16_until(in, len, len, i, out, o);
+        return { i, o, ok };
+    }
+
+    NAO_TARGET_AVX2 transcode_result utf8_to_utf32_avx2(const char* str, size_t len, char32_t* out) {
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        size_t i = 0, o = 0;
+
+        while (i + 32 <= len) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            if (_mm256_movemask_epi8(v) == 0) {
+                for (size_t k = 0; k < 32; k += 8) {
+                    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i + k));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o + k), _mm256_cvtepu8_epi32(bytes));
+                }
+
+                i += 32;
+                o += 32;
+            } else {
+                _mm256_zeroupper();
+                if (!utf8_to_utf16_until(in, len, i + 32, i, out, o)) {
+                    return { i, o, false };
+                }
+            }
+        }
+
+        bool ok = utf8_to_utf16_until(in, len, len, i, out, o);
+        return { i, o, ok };
+    }
+
+    transcode_result utf32_to_utf8_sse2(const char32_t* in, size_t len, char* out) {
+        size_t i = 0, o = 0;
+        const __m128i high = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+
+        while (i + 8 <= len) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 4));
+            __m128i over = _mm_and_si128(_mm_or_si128(a, b), high);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(over, _mm_setzero_si128())) == 0xFFFF) {
+                __m128i packed = _mm_packs_epi32(a, b);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + o), _mm_packus_epi16(packed, packed));
+                i += 8;
+                o += 8;
+            } else {
+                utf16_to_utf8_until(in, len, i + 8, i, out, o);
+            }
+        }
+
+        utf16_to_utf8_until(in, len, len, i, out, o);
+        return { i, o, true };
+    }
+
+    NAO_TARGET_AVX2 transcode_result utf32_to_utf8_avx2(const char32_t* in, size_t len, char* out) {
+        size_t i = 0, o = 0;
+        const __m256i high = _mm256_set1_epi32(static_cast<int>(0xFFFFFF80));
+
+        while (i + 16 <= len) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 8));
+            if (_mm256_testz_si256(_mm256_or_si256(a, b), high)) {
+                // Packing works per 128-bit lane, put the quarters back in order before the last step
+                __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+                __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), bytes);
+                i += 16;
+                o += 16;
+            } else {
+                _mm256_zeroupper();
+                utf16_to_utf8_until(in, len, i + 16, i, out, o);
+            }
+        }
+
+        utf16_to_utf8_until(in, len, len, i, out, o);
+        return { i, o, true };
+    }
+#elif defined(NAO_UTF_NEON)
+    transcode_result utf8_to_utf32_neon(const char* str, size_t len, char32_t* out) {
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        size_t i = 0, o = 0;
+
+        while (i + 16 <= len) {
+            uint8x16_t v = vld1q_u8(in + i);
+            if (vmaxvq_u8(v) < 0x80) {
+                uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+                uint16x8_t hi = vmovl_high_u8(v);
+                auto dst = reinterpret_cast<uint32_t*>(out + o);
+                vst1q_u32(dst, vmovl_u16(vget_low_u16(lo)));
+                vst1q_u32(dst + 4, vmovl_high_u16(lo));
+                vst1q_u32(dst + 8, vmovl_u16(vget_low_u16(hi)));
+                vst1q_u32(dst + 12, vmovl_high_u16(hi));
+                i += 16;
+                o += 16;
+            } else if (!utf8_to_utf16_until(in, len, i + 16, i, out, o)) {
+                return { i, o, false };
+            }
+        }
+
+        bool ok = utf8_to_utf16_until(in, len, len, i, out, o);
+        return { i, o, ok };
+    }
+
+    transcode_result utf32_to_utf8_neon(const char32_t* in, size_t len, char* out) {
+        size_t i = 0, o = 0;
+
+        while (i + 8 <= len) {
+            uint32x4_t a = vld1q_u32(reinterpret_cast<const uint32_t*>(in + i));
+            uint32x4_t b = vld1q_u32(reinterpret_cast<const uint32_t*>(in + i + 4));
+            if (vmaxvq_u32(vorrq_u32(a, b)) < 0x80) {
+                uint16x8_t units = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+                vst1_u8(reinterpret_cast<uint8_t*>(out + o), vmovn_u16(units));
+                i += 8;
+                o += 8;
+            } else {
+                utf16_to_utf8_until(in, len, i + 8, i, out, o);
+            }
+        }
+
+        utf16_to_utf8_until(in, len, len, i, out, o);
+        return { i, o, true };
+    }
+#endif
+
+    ///////////////////////////////////////////////////////////////////////////
+    //  Validation and ASCII scanning
+    ///////////////////////////////////////////////////////////////////////////
+
+    constexpr size_t valid = std::string_view::npos;
+
+    size_t ascii_length_scalar(const uint8_t* in, size_t len) {
+        size_t i = 0;
+        while (i + 8 <= len && ascii8(in + i)) {
+            i += 8;
+        }
+
+        while (i < len && in[i] < 0x80) {
+            ++i;
+        }
+
+        return i;
+    }
+
+    /**
+     * @brief Validates starting at `in[i]`, which must be the start of a sequence.
+     */
+    size_t validate_utf8_from(const uint8_t* in, size_t len, size_t i) {
+        while (i < len) {
+            if (in[i] < 0x80) {
+                i += (i + 8 <= len && ascii8(in + i)) ? 8 : 1;
+                continue;
+            }
+
+            char32_t cp;
+            size_t size = decode_utf8(in, len, i, cp);
+            if (size == 0) {
+                return i;
+            }
+
+            i += size;
+        }
+
+        return valid;
+    }
+
+    /**
+     * @brief Validation for kernels that can only skip ASCII quickly.
+     */
+    template <size_t(*AsciiLength)(const uint8_t*, size_t)>
+    size_t validate_utf8_ascii(const uint8_t* in, size_t len) {
+        size_t i = 0;
+        while (true) {
+            i += AsciiLength(in + i, len - i);
+            if (i == len) {
+                return valid;
+            }
+
+            char32_t cp;
+            size_t size = decode_utf8(in, len, i, cp);
+            if (size == 0) {
+                return i;
+            }
+
+            i += size;
+        }
+    }
+
+#if defined(NAO_UTF_X64)
+    size_t ascii_length_sse2(const uint8_t* in, size_t len) {
+        size_t i = 0;
+        while (i + 16 <= len) {
+            int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+            if (mask != 0) {
+                return i + std::countr_zero(static_cast<unsigned>(mask));
+            }
+
+            i += 16;
+        }
+
+        return i + ascii_length_scalar(in + i, len - i);
+    }
+
+    NAO_TARGET_AVX2 size_t ascii_length_avx2(const uint8_t* in, size_t len) {
+        size_t i = 0;
+        while (i + 32 <= len) {
+            int mask = _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+            if (mask != 0) {
+                return i + std::countr_zero(static_cast<unsigned>(mask));
+            }
+
+            i += 32;
+        }
+
+        return i + ascii_length_scalar(in + i, len - i);
+    }
+
+    /**
+     * @brief The 32 bytes ending `N` bytes before the end of `input`.
+     */
+    template <int N>
+    NAO_TARGET_AVX2 __m256i prev_bytes(__m256i input, __m256i prev_input) {
+        return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev_input, input, 0x21), 16 - N);
+    }
+
+    NAO_TARGET_AVX2 __m256i lookup16(__m256i indices, uint8_t v0, uint8_t v1, uint8_t v2, uint8_t v3,
+        uint8_t v4, uint8_t v5, uint8_t v6, uint8_t v7, uint8_t v8, uint8_t v9, uint8_t v10, uint8_t v11,
+        uint8_t v12, uint8_t v13, uint8_t v14, uint8_t v15) {
+        __m256i table = _mm256_setr_epi8(
+            v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15,
+            v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15);
+        return _mm256_shuffle_epi8(table, indices);
+    }
+
+    /**
+     * @brief Non-zero bytes mark errors in `input`, or at the end of `prev_input`.
+     */
+    NAO_TARGET_AVX2 __m256i utf8_block_errors(__m256i input, __m256i prev_input) {
+        constexpr uint8_t too_short = 1 << 0;
+        constexpr uint8_t too_long = 1 << 1;
+        constexpr uint8_t overlong_3 = 1 << 2;
+        constexpr uint8_t too_large = 1 << 3;
+        constexpr uint8_t surrogate = 1 << 4;
+        constexpr uint8_t overlong_2 = 1 << 5;
+        constexpr uint8_t too_large_1000 = 1 << 6;
+        constexpr uint8_t overlong_4 = 1 << 6;
+        constexpr uint8_t two_conts = 1 << 7;
+        constexpr uint8_t carry = too_short | too_long | two_conts;
+
+        const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+        __m256i prev1 = prev_bytes<1>(input, prev_input);
+
+        __m256i byte_1_high = lookup16(_mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble),
+            // ASCII
+            too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+            // Continuation
+            two_conts, two_conts, two_conts, two_conts,
+            // 2 byte lead
+            too_short | overlong_2,
+            too_short,
+            // 3 byte lead
+            too_short | overlong_3 | surrogate,
+            // 4 byte lead
+            too_short | too_large | too_large_1000 | overlong_4);
+
+        __m256i byte_1_low = lookup16(_mm256_and_si256(prev1, low_nibble),
+            carry | overlong_3 | overlong_2 | overlong_4,
+            carry | overlong_2,
+            carry,
+            carry,
+            carry | too_large,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000 | surrogate,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000);
+
+        __m256i byte_2_high = lookup16(_mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble),
+            // ASCII
+            too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+            // 0x80 - 0x8F
+            too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+            // 0x90 - 0x9F
+            too_long | overlong_2 | two_conts | overlong_3 | too_large,
+            // 0xA0 - 0xBF
+            too_long | overlong_2 | two_conts | surrogate | too_large,
+            too_long | overlong_2 | two_conts | surrogate | too_large,
+            // Lead bytes
+            too_short, too_short, too_short, too_short);
+
+        __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+        // Third and fourth bytes of a sequence have to be continuations, which is the
+        // one case the two byte lookup above reports as an error
+        __m256i prev2 = prev_bytes<2>(input, prev_input);
+        __m256i prev3 = prev_bytes<3>(input, prev_input);
+        __m256i is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+        __m256i is_fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+        __m256i must_be_cont = _mm256_and_si256(_mm256_or_si256(is_third, is_fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+        return _mm256_xor_si256(must_be_cont, special);
+    }
+
+    /**
+     * @brief Non-zero bytes mark a sequence that is cut off by the end of `input`.
+     */
+    NAO_TARGET_AVX2 __m256i utf8_block_incomplete(__m256i input) {
+        const __m256i max = _mm256_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+        return _mm256_subs_epu8(input, max);
+    }
+
+    NAO_TARGET_AVX2 size_t validate_utf8_avx2(const uint8_t* in, size_t len) {
+        __m256i prev_input = _mm256_setzero_si256();
+        __m256i prev_incomplete = _mm256_setzero_si256();
+        size_t i = 0;
+
+        // Only tells whether a block is valid, the scalar decoder finds the exact offset.
+        // Everything before `block` passed, except maybe a sequence started in its last
+        // 3 bytes, so the first lead byte among those is where decoding can resume.
+        auto locate = [in, len](size_t block) {
+            size_t start = block < 3 ? 0 : block - 3;
+            while (start < block && is_continuation(in[start])) {
+                ++start;
+            }
+
+            return validate_utf8_from(in, len, start);
+        };
+
+        while (i < len) {
+            __m256i v;
+            if (i + 32 <= len) {
+                v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            } else {
+                // Zero padding is ASCII, so it also catches a sequence cut off by the end
+                alignas(32) uint8_t tail[32] {};
+                std::memcpy(tail, in + i, len - i);
+                v = _mm256_load_si256(reinterpret_cast<const __m256i*>(tail));
+            }
+
+            __m256i error;
+            if (_mm256_movemask_epi8(v) == 0) {
+                error = prev_incomplete;
+                prev_incomplete = _mm256_setzero_si256();
+            } else {
+                error = utf8_block_errors(v, prev_input);
+                prev_incomplete = utf8_block_incomplete(v);
+            }
+
+            if (!_mm256_testz_si256(error, error)) {
+                return locate(i);
+            }
+
+            prev_input = v;
+            i += 32;
+        }
+
+        if (!_mm256_testz_si256(prev_incomplete, prev_incomplete)) {
+            return locate(i - 32);
+        }
+
+        return valid;
+    }
+#elif defined(NAO_UTF_NEON)
+    size_t ascii_length_neon(const uint8_t* in, size_t len) {
+        size_t i = 0;
+        while (i + 16 <= len && vmaxvq_u8(vld1q_u8(in + i)) < 0x80) {
+            i += 16;
+        }
+
+        return i + ascii_length_scalar(in + i, len - i);
+    }
+#endif
+
+    /**
+     * @brief Kernels working on bytes only, selected once.
+     */
+    struct byte_kernels {
+        using ascii_length_func = size_t(*)(const uint8_t*, size_t);
+        using validate_func = size_t(*)(const uint8_t*, size_t);
+
+        ascii_length_func ascii_length = &ascii_length_scalar;
+        validate_func validate = &validate_utf8_ascii<ascii_length_scalar>;
+
+        byte_kernels() {
+#if defined(NAO_UTF_X64)
+            if (has_avx2()) {
+                ascii_length = &ascii_length_avx2;
+                validate = &validate_utf8_avx2;
+            } else {
+                ascii_length = &ascii_length_sse2;
+                validate = &validate_utf8_ascii<ascii_length_sse2>;
+            }
+#elif defined(NAO_UTF_NEON)
+            ascii_length = &ascii_length_neon;
+            validate = &validate_utf8_ascii<ascii_length_neon>;
+#endif
+        }
+
+        static const byte_kernels& get() {
+            static const byte_kernels instance;
+            return instance;
+        }
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    //  Latin-1
+    ///////////////////////////////////////////////////////////////////////////
+
+    transcode_result latin1_to_utf8_kernel(const char* str, size_t len, char* out) {
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        auto ascii_length = byte_kernels::get().ascii_length;
+        size_t i = 0, o = 0;
+
+        while (i < len) {
+            size_t run = ascii_length(in + i, len - i);
+            std::memcpy(out + o, in + i, run);
+            i += run;
+            o += run;
+
+            for (; i < len && in[i] >= 0x80; ++i) {
+                out[o++] = static_cast<char>(0xC0 | (in[i] >> 6));
+                out[o++] = static_cast<char>(0x80 | (in[i] & 0x3F));
+            }
+        }
+
+        return { i, o, true };
+    }
+
+    /**
+     * @note Also fails on valid UTF-8 that is outside of Latin-1, check `read` to tell which.
+     */
+    transcode_result utf8_to_latin1_kernel(const char* str, size_t len, char* out) {
+        auto in = reinterpret_cast<const uint8_t*>(str);
+        auto ascii_length = byte_kernels::get().ascii_length;
+        size_t i = 0, o = 0;
+
+        while (i < len) {
+            size_t run = ascii_length(in + i, len - i);
+            std::memcpy(out + o, in + i, run);
+            i += run;
+            o += run;
+
+            while (i < len && in[i] >= 0x80) {
+                // U+0080 - U+00FF are the 2 byte sequences led by 0xC2 and 0xC3
+                if ((in[i] & 0xFE) != 0xC2 || i + 1 == len || !is_continuation(in[i + 1])) {
+                    return { i, o, false };
+                }
+
+                out[o++] = static_cast<char>(((in[i] & 0x03) << 6) | (in[i + 1] & 0x3F));
+                i += 2;
+            }
+        }
+
+        return { i, o, true };
+    }
+
+    /**
+     * @brief The best kernels for this CPU and unit type, selected once.
+     * @note For char32_t, to_utf16 converts to UTF-32.
+     */
+    template <typename CharT>
+    struct kernels {
+        using to_utf16_func = transcode_result(*)(const char*, size_t, CharT*);
+        using to_utf8_func = transcode_result(*)(const CharT*, size_t, char*);
+
+        to_utf16_func to_utf16 = &utf8_to_utf16_scalar<CharT>;
+        to_utf8_func to_utf8 = &utf16_to_utf8_scalar<CharT>;
+
+        kernels() {
+            if constexpr (is_utf32<CharT>) {
+#if defined(NAO_UTF_X64)
+                if (has_avx2()) {
+                    to_utf16 = &utf8_to_utf32_avx2;
+                    to_utf8 = &utf32_to_utf8_avx2;
+                } else {
+                    to_utf16 = &utf8_to_utf32_sse2;
+                    to_utf8 = &utf32_to_utf8_sse2;
+                }
+#elif defined(NAO_UTF_NEON)
+                to_utf16 = &utf8_to_utf32_neon;
+                to_utf8 = &utf32_to_utf8_neon;
+#endif
+            } else if constexpr (simd_unit<CharT>) {
+#if defined(NAO_UTF_X64)
+                if (has_avx2()) {
+                    to_utf16 = &utf8_to_utf16_avx2<CharT>;
+                    to_utf8 = &utf16_to_utf8_avx2<CharT>;
+                } else if (has_ssse3()) {
+                    to_utf16 = &utf8_to_utf16_ssse3<CharT>;
+                    to_utf8 = &utf16_to_utf8_ssse3<CharT>;
+                } else {
+                    to_utf16 = &utf8_to_utf16_sse2<CharT>;
+                    to_utf8 = &utf16_to_utf8_sse2<CharT>;
+                }
+#elif defined(NAO_UTF_NEON)
+                to_utf16 = &utf8_to_utf16_neon<CharT>;
+                to_utf8 = &utf16_to_utf8_neon<CharT>;
+#endif
+            }
+        }
+
+        static const kernels& get() {
+            static const kernels instance;
+            return instance;
+        }
+    };
+
+    /**
+     * @brief Grows `result` by the worst case, converts in a single pass and shrinks it to fit.
+     * @param convert - Writes to the pointer it is passed, returns the result of the conversion
+     */
+    template <typename StringT, typename Func>
+    transcode_result append_into(StringT& result, size_t max_size, Func&& convert) {
+        size_t old_size = result.size();
+        transcode_result res;
+
+#ifdef __cpp_lib_string_resize_and_overwrite
+        result.resize_and_overwrite(old_size + max_size, [&](auto* data, size_t) {
+            res = convert(data + old_size);
+            return old_size + (res.ok ? res.written : 0);
+            });
+#else
+        result.resize(old_size + max_size);
+        res = convert(result.data() + old_size);
+        result.resize(old_size + (res.ok ? res.written : 0));
+#endif
+
+        return res;
+    }
+
+    [[noreturn]] void throw_invalid_utf8() {
+        throw std::runtime_error("failed converting narrow string to wide string");
+    }
+
+    template <typename CharT>
+    size_t to_utf16_buffer(std::string_view str, CharT* out) {
+        transcode_result res = kernels<CharT>::get().to_utf16(str.data(), str.size(), out);
+        if (!res.ok) {
+            throw_invalid_utf8();
+        }
+
+        return res.written;
+    }
+
+    template <typename CharT>
+    void append_utf16_impl(std::basic_string<CharT>& dst, std::string_view str) {
+        transcode_result res = append_into(dst, nao::utf16_length_bound(str.size()), [str](CharT* data) {
+            return kernels<CharT>::get().to_utf16(str.data(), str.size(), data);
+            });
+
+        if (!res.ok) {
+            throw_invalid_utf8();
+        }
+    }
+
+    template <typename CharT>
+    void append_utf8_impl(std::string& dst, std::basic_string_view<CharT> str) {
+        append_into(dst, nao::utf8_length_bound<CharT>(str.size()), [str](char* data) {
+            return kernels<CharT>::get().to_utf8(str.data(), str.size(), data);
+            });
+    }
+
+    /**
+     * @return Length of the sequence started by `c`, 0 if it cannot start one.
+     */
+    size_t utf8_sequence_length(uint8_t c) {
+        if (c < 0x80) {
+            return 1;
+        } else if (c < 0xC2) {
+            return 0;
+        } else if (c < 0xE0) {
+            return 2;
+        } else if (c < 0xF0) {
+            return 3;
+        } else if (c < 0xF5) {
+            return 4;
+        }
+
+        return 0;
+    }
+
+    template <typename CharT>
+    void utf8_stream_feed(char (&pending)[4], size_t& pending_size,
+        std::string_view chunk, std::basic_string<CharT>& out) {
+        if (pending_size > 0) {
+            // Only valid lead bytes are ever kept
+            size_t needed = utf8_sequence_length(static_cast<uint8_t>(pending[0]));
+            size_t take = std::min(needed - pending_size, chunk.size());
+            std::memcpy(pending + pending_size, chunk.data(), take);
+            pending_size += take;
+            chunk.remove_prefix(take);
+
+            if (pending_size < needed) {
+                return;
+            }
+
+            append_utf16_impl(out, { pending, pending_size });
+            pending_size = 0;
+        }
+
+        // Hold back a sequence that is cut off by the end of the chunk
+        size_t keep = 0;
+        for (size_t back = 1; back <= std::min<size_t>(3, chunk.size()); ++back) {
+            auto c = static_cast<uint8_t>(chunk[chunk.size() - back]);
+            if (!is_continuation(c)) {
+                if (utf8_sequence_length(c) > back) {
+                    keep = back;
+                }
+
+                break;
+            }
+        }
+
+        append_utf16_impl(out, chunk.substr(0, chunk.size() - keep));
+        std::memcpy(pending, chunk.data() + chunk.size() - keep, keep);
+        pending_size = keep;
+    }
+
+    bool is_high_surrogate(char32_t c) {
+        return c >= 0xD800 && c <= 0xDBFF;
+    }
+
+    bool is_low_surrogate(char32_t c) {
+        return c >= 0xDC00 && c <= 0xDFFF;
+    }
+
+    template <typename CharT>
+    void utf16_stream_feed(char32_t& pending, std::basic_string_view<CharT> chunk, std::string& out) {
+        if (chunk.empty()) {
+            return;
+        }
+
+        if (pending) {
+            CharT pair[2] = { static_cast<CharT>(pending), chunk[0] };
+            bool completed = is_low_surrogate(static_cast<char32_t>(chunk[0]));
+            append_utf8_impl<CharT>(out, { pair, completed ? 2u : 1u });
+
+            if (completed) {
+                chunk.remove_prefix(1);
+            }
+
+            pending = 0;
+        }
+
+        // A high surrogate at the end may be completed by the next chunk
+        if (!chunk.empty() && is_high_surrogate(static_cast<char32_t>(chunk.back()))) {
+            pending = static_cast<char32_t>(chunk.back());
+            chunk.remove_suffix(1);
+        }
+
+        append_utf8_impl(out, chunk);
+    }
+}
+
+namespace nao {
+    std::wstring to_utf16(std::string_view str) {
+        std::wstring result;
+        append_utf16_impl(result, str);
+        return result;
+    }
+
+    std::u16string to_u16string(std::string_view str) {
+        std::u16string result;
+        append_utf16_impl(result, str);
+        return result;
+    }
+
+    std::string to_utf8(std::wstring_view str) {
+        std::string result;
+        append_utf8_impl(result, str);
+        return result;
+    }
+
+    std::string to_utf8(std::u16string_view str) {
+        std::string result;
+        append_utf8_impl(result, str);
+        return result;
+    }
+
+    size_t to_utf16(std::string_view str, wchar_t* out) {
+        return to_utf16_buffer(str, out);
+    }
+
+    size_t to_utf16(std::string_view str, char16_t* out) {
+        return to_utf16_buffer(str, out);
+    }
+
+    size_t to_utf8(std::wstring_view str, char* out) {
+        return kernels<wchar_t>::get().to_utf8(str.data(), str.size(), out).written;
+    }
+
+    size_t to_utf8(std::u16string_view str, char* out) {
+        return kernels<char16_t>::get().to_utf8(str.data(), str.size(), out).written;
+    }
+
+    void append_utf16(std::wstring& dst, std::string_view str) {
+        append_utf16_impl(dst, str);
+    }
+
+    void append_utf16(std::u16string& dst, std::string_view str) {
+        append_utf16_impl(dst, str);
+    }
+
+    void append_utf8(std::string& dst, std::wstring_view str) {
+        append_utf8_impl(dst, str);
+    }
+
+    void append_utf8(std::string& dst, std::u16string_view str) {
+        append_utf8_impl(dst, str);
+    }
+
+    size_t to_utf32(std::string_view str, char32_t* out) {
+        return to_utf16_buffer(str, out);
+    }
+
+    std::u32string to_utf32(std::string_view str) {
+        std::u32string result;
+        append_utf16_impl(result, str);
+        return result;
+    }
+
+    void append_utf32(std::u32string& dst, std::string_view str) {
+        append_utf16_impl(dst, str);
+    }
+
+    size_t to_utf8(std::u32string_view str, char* out) {
+        return kernels<char32_t>::get().to_utf8(str.data(), str.size(), out).written;
+    }
+
+    std::string to_utf8(std::u32string_view str) {
+        std::string result;
+        append_utf8_impl(result, str);
+        return result;
+    }
+
+    void append_utf8(std::string& dst, std::u32string_view str) {
+        append_utf8_impl(dst, str);
+    }
+
+    size_t validate_utf8(std::string_view str) {
+        return byte_kernels::get().validate(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+    }
+
+    std::string latin1_to_utf8(std::string_view str) {
+        std::string result;
+        append_into(result, 2 * str.size(), [str](char* data) {
+            return latin1_to_utf8_kernel(str.data(), str.size(), data);
+            });
+
+        return result;
+    }
+
+    std::string utf8_to_latin1(std::string_view str) {
+        std::string result;
+        transcode_result res = append_into(result, str.size(), [str](char* data) {
+            return utf8_to_latin1_kernel(str.data(), str.size(), data);
+            });
+
+        if (!res.ok) {
+            char32_t cp;
+            if (decode_utf8(reinterpret_cast<const uint8_t*>(str.data()), str.size(), res.read, cp) == 0) {
+                throw std::runtime_error("failed converting invalid UTF-8 to Latin-1");
+            }
+
+            throw std::runtime_error("string contains characters outside of Latin-1");
+        }
+
+        return result;
+    }
+
+    void utf8_to_utf16_stream::feed(std::string_view chunk, std::wstring& out) {
+        utf8_stream_feed(_pending, _pending_size, chunk, out);
+    }
+
+    void utf8_to_utf16_stream::feed(std::string_view chunk, std::u16string& out) {
+        utf8_stream_feed(_pending, _pending_size, chunk, out);
+    }
+
+    void utf8_to_utf16_stream::finish() {
+        bool incomplete = _pending_size > 0;
+        _pending_size = 0;
+
+        if (incomplete) {
+            throw_invalid_utf8();
+        }
+    }
+
+    void utf16_to_utf8_stream::feed(std::wstring_view chunk, std::string& out) {
+        utf16_stream_feed(_pending, chunk, out);
+    }
+
+    void utf16_to_utf8_stream::feed(std::u16string_view chunk, std::string& out) {
+        utf16_stream_feed(_pending, chunk, out);
+    }
+
+    void utf16_to_utf8_stream::finish(std::string& out) {
+        if (_pending) {
+            // An unpaired high surrogate is replaced, same as in the middle of the input
+            out.append("\xEF\xBF\xBD");
+            _pending = 0;
+        }
+    }
+}
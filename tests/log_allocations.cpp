@@ -0,0 +1,218 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "nao/logging.h"
+#include "nao/log_sink.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * Checks that logging does not allocate on the calling thread once warmed up
+ */
+
+namespace {
+    // Only allocations made by the thread that logs count, the log thread may allocate in its sink
+    thread_local uint64_t thread_allocations = 0;
+
+    void* counted_alloc(size_t size) {
+        ++thread_allocations;
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* counted_alloc(size_t size, std::align_val_t align) {
+        ++thread_allocations;
+
+        // aligned_alloc wants a multiple of the alignment
+        auto alignment = static_cast<size_t>(align);
+        size = (size + alignment - 1) & ~(alignment - 1);
+#ifdef _WIN32
+        return _aligned_malloc(size == 0 ? alignment : size, alignment);
+#else
+        return std::aligned_alloc(alignment, size == 0 ? alignment : size);
+#endif
+    }
+
+    void counted_free(void* ptr, std::align_val_t) noexcept {
+#ifdef _WIN32
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+
+    // Holds the log thread in write() while closed, so that the queue fills up completely
+    class gated_sink : public nao::log_sink {
+        std::atomic<bool> _open { true };
+        std::atomic<bool> _held { false };
+
+        public:
+        void write(std::span<const std::string_view>) override {
+            while (!_open.load()) {
+                _held.store(true);
+                std::this_thread::yield();
+            }
+        }
+
+        void close() {
+            _held.store(false);
+            _open.store(false);
+        }
+
+        void open() {
+            _open.store(true);
+        }
+
+        // Waits until the log thread is stuck in write()
+        void wait_held() const {
+            while (!_held.load()) {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    constexpr int queue_capacity = 2048;
+    constexpr int lines = 10000;
+
+    // Longer than any line logged while counting, so every buffer grows to fit those.
+    // A view, as cout(std::string) takes its own copy and would bypass the thread's format buffer.
+    const std::string warm_up_text(200, 'w');
+    const std::string_view warm_up_line { warm_up_text };
+
+    int failures = 0;
+
+    template <typename Func>
+    void expect_no_allocations(const char* name, Func&& log_line) {
+        uint64_t before = thread_allocations;
+        for (int i = 0; i < lines; ++i) {
+            log_line(i);
+        }
+
+        uint64_t allocations = thread_allocations - before;
+        nao::flush();
+
+        std::printf("%-14s %llu allocations in %d lines\n", name,
+            static_cast<unsigned long long>(allocations), lines);
+        if (allocations != 0) {
+            ++failures;
+        }
+    }
+}
+
+void* operator new(size_t size) {
+    if (void* p = counted_alloc(size)) {
+        return p;
+    }
+
+    throw std::bad_alloc {};
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    if (void* p = counted_alloc(size, align)) {
+        return p;
+    }
+
+    throw std::bad_alloc {};
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t align) noexcept {
+    counted_free(ptr, align);
+}
+
+void operator delete[](void* ptr, std::align_val_t align) noexcept {
+    counted_free(ptr, align);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept {
+    counted_free(ptr, align);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t align) noexcept {
+    counted_free(ptr, align);
+}
+
+int main() {
+    auto owned_sink = std::make_unique<gated_sink>();
+    gated_sink& sink = *owned_sink;
+    nao::set_log_sink(std::move(owned_sink));
+    nao::set_log_overflow(nao::log_overflow::block);
+
+    /*
+     * The queue and the log thread's batch swap strings, so each one has to have
+     * held a long line before the queue stops allocating. Draining a full queue
+     * at once makes the batch as large as it gets.
+     */
+    for (int round = 0; round < 4; ++round) {
+        sink.close();
+        nao::cout(warm_up_line);
+        sink.wait_held();
+        for (int i = 0; i < queue_capacity; ++i) {
+            nao::cout(warm_up_line);
+        }
+
+        sink.open();
+        nao::flush();
+    }
+
+    expect_no_allocations("cout", [](int i) { nao::cout("line", i, "of", lines, 0.5 * i); });
+    expect_no_allocations("coutln", [](int i) { nao::coutln("line", i, true, 'c'); });
+    expect_no_allocations("cout_deferred", [](int i) { nao::cout_deferred<"line {} of {}\n">(i, lines); });
+    expect_no_allocations("info", [](int i) { nao::info("line", i); });
+#ifdef __cpp_lib_format
+    expect_no_allocations("coutf", [](int i) { nao::coutfln("line {} of {}", i, lines); });
+#endif
+
+    nao::set_log_sink(std::make_unique<nao::memory_sink>());
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,152 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "vdf_gen.h"
+
+#include <vdf_parser.h>
+
+#include "legacy/vdf_parser.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <string>
+#include <string_view>
+
+/**
+ * Differential fuzz of vdf_parser.h against the parser it replaced. Random
+ * documents stress escapes, comments and whitespace at every position, the
+ * generated ones are long enough to cross the tokenizer's scan blocks.
+ */
+
+namespace {
+    std::mt19937_64 rng { 42 };
+
+    template <size_t N>
+    std::string_view pick(const std::string_view (&choices)[N]) {
+        return choices[rng() % N];
+    }
+
+    template <size_t N>
+    std::string repeat(const std::string_view (&parts)[N], size_t max_length) {
+        std::string str;
+        for (size_t i = rng() % (max_length + 1); i > 0; --i) {
+            str.append(pick(parts));
+        }
+
+        return str;
+    }
+
+    // Contents of a quoted token: escapes known and unknown, braces, spaces and non-ASCII text
+    std::string quoted() {
+        static constexpr std::string_view parts[] = { "a", "b", "\\\"", "\\\\", "\\q", " ", "/", "x y", "\t", "{", "}", "é" };
+        return '"' + repeat(parts, 4) + '"';
+    }
+
+    // Unquoted tokens end at whitespace, backslashes inside them are taken literally
+    std::string word() {
+        static constexpr std::string_view parts[] = { "a", "b", "\\\\z", "\\z", "k1", "/x", "\\ q" };
+        return 'w' + repeat(parts, 2);
+    }
+
+    std::string token() {
+        return rng() % 4 != 0 ? quoted() : word();
+    }
+
+    std::string_view space() {
+        static constexpr std::string_view spaces[] = { " ", "\n", "\t\t", " // comment\n", " /* block */", " \r\n" };
+        return pick(spaces);
+    }
+
+    void object(std::string& out, int depth) {
+        out.append(token()).append(space()).append("{").append(space());
+        for (size_t i = rng() % 6; i > 0; --i) {
+            if (rng() % 4 == 0 && depth < 4) {
+                object(out, depth + 1);
+            } else {
+                out.append(token()).append(space()).append(token()).append(space());
+            }
+        }
+
+        out.append("}").append(space());
+    }
+
+    template <typename LegacyT, typename ObjectT>
+    bool same(const LegacyT& legacy, const ObjectT& current) {
+        if (legacy.name != current.name || legacy.attribs != current.attribs
+            || legacy.childs.size() != current.childs.size()) {
+            return false;
+        }
+
+        for (const auto& [key, child] : legacy.childs) {
+            auto it = current.childs.find(key);
+            if (it == current.childs.end() || !same(*child, *it->second)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    int failures = 0;
+
+    void compare(std::string_view name, const std::string& text) {
+        tyti_legacy::vdf::object legacy;
+        tyti::vdf::object current;
+        bool legacy_threw = false;
+        bool current_threw = false;
+
+        try {
+            legacy = tyti_legacy::vdf::read<tyti_legacy::vdf::object>(text.begin(), text.end());
+        } catch (const std::exception&) {
+            legacy_threw = true;
+        }
+
+        try {
+            current = tyti::vdf::read<tyti::vdf::object>(text.begin(), text.end());
+        } catch (const std::exception&) {
+            current_threw = true;
+        }
+
+        if (legacy_threw != current_threw || (!legacy_threw && !same(legacy, current))) {
+            // Generated documents are too long to print, they can be recreated from the seed
+            if (failures++ < 5) {
+                std::printf("%.*s: parsers differ (legacy threw %d, current threw %d)\n%s\n",
+                    static_cast<int>(name.size()), name.data(), legacy_threw, current_threw,
+                    text.size() < 4096 ? text.c_str() : "");
+            }
+        }
+    }
+}
+
+int main() {
+    constexpr int documents = 50000;
+    for (int i = 0; i < documents; ++i) {
+        std::string text;
+        for (size_t roots = 1 + rng() % 2; roots > 0; --roots) {
+            object(text, 0);
+        }
+
+        compare("random", text);
+    }
+
+    for (uint64_t seed = 1; seed <= 3; ++seed) {
+        compare("generated", bench::generate_vdf(size_t { 1 } << 20, seed));
+    }
+
+    std::printf("%d of %d documents differ\n", failures, documents + 3);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+/*  This file is part of libnao-util.
+
+    libnao-util is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao-util is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libnao-util.  If not, see <https://www.gnu.org/licenses/>.   */
+
+#include "vdf_gen.h"
+
+#include <vdf_parser.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <istream>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+/**
+ * Feeds documents to the push parser in random splits, including empty chunks
+ * and splits inside tokens, escapes and comments, and checks that the handler
+ * sees the same events as with parse() on the whole text. Also reads them from
+ * a stream that can't seek.
+ */
+
+namespace {
+    std::mt19937_64 rng { 7 };
+
+    template <size_t N>
+    std::string_view pick(const std::string_view (&choices)[N]) {
+        return choices[rng() % N];
+    }
+
+    template <size_t N>
+    std::string repeat(const std::string_view (&parts)[N], size_t max_length) {
+        std::string str;
+        for (size_t i = rng() % (max_length + 1); i > 0; --i) {
+            str.append(pick(parts));
+        }
+
+        return str;
+    }
+
+    // Comment openers inside quotes must not start a comment when split after the slash
+    std::string quoted() {
+        static constexpr std::string_view parts[] = { "a", "b", "\\\"", "\\\\", "\\q", " ", "/", "x y", "\t", "{", "}", "é", "*", "/*", "//" };
+        return '"' + repeat(parts, 4) + '"';
+    }
+
+    std::string word() {
+        static constexpr std::string_view parts[] = { "a", "b", "\\\\z", "\\z", "k1", "/x", "\\ q" };
+        return 'w' + repeat(parts, 2);
+    }
+
+    std::string token() {
+        return rng() % 4 != 0 ? quoted() : word();
+    }
+
+    std::string_view space() {
+        static constexpr std::string_view spaces[] = { " ", "\n", "\t\t", " // comment\n", " /* block */", " /* a * b ** / c **/", " //x*/\n", " \r\n" };
+        return pick(spaces);
+    }
+
+    void object(std::string& out, int depth) {
+        out.append(token()).append(space()).append("{").append(space());
+        for (size_t i = rng() % 6; i > 0; --i) {
+            if (rng() % 4 == 0 && depth < 4) {
+                object(out, depth + 1);
+            } else {
+                out.append(token()).append(space()).append(token()).append(space());
+            }
+        }
+
+        out.append("}").append(space());
+    }
+
+    // Logs every event and stops the parser after a number of them
+    class recorder {
+        size_t _limit;
+        size_t _events = 0;
+
+        public:
+        std::string log;
+
+        explicit recorder(size_t limit) : _limit { limit } { }
+
+        bool on_object_begin(std::string_view name) {
+            log.append("B[").append(name).append("]");
+            return ++_events < _limit;
+        }
+
+        bool on_key_value(std::string_view key, std::string_view value) {
+            log.append("K[").append(key).append("]=").append(value).append(";");
+            return ++_events < _limit;
+        }
+
+        bool on_object_end() {
+            log.append("E");
+            return ++_events < _limit;
+        }
+    };
+
+    struct outcome {
+        std::string log;
+        bool ok = false;
+        bool threw = false;
+
+        bool operator==(const outcome& other) const {
+            return log == other.log && ok == other.ok && threw == other.threw;
+        }
+    };
+
+    outcome parse_whole(const std::string& text, size_t limit) {
+        recorder handler { limit };
+        outcome result;
+        try {
+            result.ok = tyti::vdf::parse(text.begin(), text.end(), handler);
+        } catch (const std::exception&) {
+            result.threw = true;
+        }
+
+        result.log = std::move(handler.log);
+        return result;
+    }
+
+    // Every chunk is copied so the parser can't keep pointers into earlier ones
+    outcome parse_split(const std::string& text, size_t limit, size_t max_chunk) {
+        recorder handler { limit };
+        outcome result;
+        try {
+            tyti::vdf::push_parser<recorder> parser { handler };
+            bool more = true;
+            for (size_t pos = 0; more && pos < text.size();) {
+                const size_t size = std::min<size_t>(rng() % (max_chunk + 1), text.size() - pos);
+                const std::string chunk = text.substr(pos, size);
+                more = parser.feed(chunk.data(), chunk.size());
+                pos += size;
+            }
+
+            result.ok = more && parser.finish();
+        } catch (const std::exception&) {
+            result.threw = true;
+        }
+
+        result.log = std::move(handler.log);
+        return result;
+    }
+
+    // Hands out a few bytes per underflow and aborts if anyone tries to seek
+    class unseekable_buffer : public std::streambuf {
+        std::string _text;
+        size_t _pos = 0;
+
+        public:
+        explicit unseekable_buffer(std::string text) : _text { std::move(text) } { }
+
+        protected:
+        int_type underflow() override {
+            if (_pos >= _text.size()) {
+                return traits_type::eof();
+            }
+
+            const size_t size = std::min<size_t>(3, _text.size() - _pos);
+            setg(_text.data() + _pos, _text.data() + _pos, _text.data() + _pos + size);
+            _pos += size;
+            return traits_type::to_int_type(*gptr());
+        }
+
+        pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode) override {
+            std::abort();
+        }
+
+        pos_type seekpos(pos_type, std::ios_base::openmode) override {
+            std::abort();
+        }
+    };
+
+    template <typename ObjectT>
+    bool same(const ObjectT& lhs, const ObjectT& rhs) {
+        if (lhs.name != rhs.name || lhs.attribs != rhs.attribs || lhs.childs.size() != rhs.childs.size()) {
+            return false;
+        }
+
+        for (const auto& [key, child] : lhs.childs) {
+            auto it = rhs.childs.find(key);
+            if (it == rhs.childs.end() || !same(*child, *it->second)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    int failures = 0;
+
+    void report(std::string_view what, const std::string& text) {
+        if (failures++ < 5) {
+            std::printf("%.*s differs\n%s\n", static_cast<int>(what.size()), what.data(),
+                text.size() < 4096 ? text.c_str() : "");
+        }
+    }
+
+    void compare_split(const std::string& text, size_t limit) {
+        const outcome whole = parse_whole(text, limit);
+        for (size_t max_chunk : { 1, 6, 200 }) {
+            if (!(parse_split(text, limit, max_chunk) == whole)) {
+                report("split parse", text);
+            }
+        }
+    }
+
+    void compare_stream(const std::string& text) {
+        unseekable_buffer buffer { text };
+        std::istream in { &buffer };
+        std::error_code ec;
+        const tyti::vdf::object streamed = tyti::vdf::read(in, ec);
+
+        tyti::vdf::object whole;
+        bool threw = false;
+        try {
+            whole = tyti::vdf::read<tyti::vdf::object>(text.begin(), text.end());
+        } catch (const std::exception&) {
+            threw = true;
+        }
+
+        if (static_cast<bool>(ec) != threw || (!threw && !same(streamed, whole))) {
+            report("stream read", text);
+        }
+    }
+}
+
+int main() {
+    constexpr int documents = 30000;
+    for (int i = 0; i < documents; ++i) {
+        std::string text;
+        for (size_t roots = 1 + rng() % 2; roots > 0; --roots) {
+            object(text, 0);
+        }
+
+        // Truncated and corrupted documents have to fail at the same event
+        switch (rng() % 4) {
+            case 1:
+                text.resize(rng() % (text.size() + 1));
+                break;
+            case 2:
+                text.insert(rng() % (text.size() + 1), 1, "\"{}/*\\ \n"[rng() % 8]);
+                break;
+        }
+
+        const size_t limit = rng() % 5 == 0 ? rng() % 20 : SIZE_MAX;
+        compare_split(text, limit);
+        compare_stream(text);
+    }
+
+    for (uint64_t seed = 1; seed <= 2; ++seed) {
+        const std::string text = bench::generate_vdf(size_t { 1 } << 20, seed);
+        compare_split(text, SIZE_MAX);
+        compare_stream(text);
+    }
+
+    std::printf("%d of %d documents differ\n", failures, documents + 2);
+    return failures == 0 ? 0 : 1;
+}